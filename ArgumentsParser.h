@@ -1,9 +1,45 @@
 #pragma once
+#include <cstdint>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <vector>
+
+#include "Automata/DontCarePartition.h"
+#include "Automata/PartitionAlgorithm.h"
+#include "Utils/WorkerPool.h"
 
 const std::string MEALY = "mealy";
 const std::string MOORE = "moore";
+const std::string SERVE = "serve";
+const std::string PRODUCT = "product";
+const std::string SERIES = "series";
+const std::string BATCH = "batch";
+
+// input or output file name meaning stdin or stdout
+const std::string STANDARD_STREAM = "-";
+
+const std::string CANONICAL_OPTION = "--canonical";
+const std::string CACHE_DIR_OPTION = "--cache-dir=";
+const std::string CACHE_SIZE_OPTION = "--cache-size=";
+const std::string DONT_CARE_OPTION = "--dont-care=";
+const std::string DONT_CARE_MODE_OPTION = "--dont-care-mode=";
+const std::string THREADS_OPTION = "--threads=";
+const std::string AFFINITY_OPTION = "--affinity=";
+const std::string ALGORITHM_OPTION = "--algorithm=";
+const std::string STATS_OPTION = "--stats";
+const std::string TRACE_OPTION = "--trace=";
+const std::string MAX_REQUEST_SIZE_OPTION = "--max-request-size=";
+const std::string MAX_CONNECTIONS_OPTION = "--max-connections=";
+
+const std::string USAGE = "Must be: <automata> <inputFilename|-> <outputFilename|-> [options],"
+    " product|series <firstMealyFilename> <secondMealyFilename> <outputFilename|-> [options],"
+    " batch <automata> <outputDirectory> <inputFilename>... [options]"
+    " or serve <socketPath> [options]."
+    " Options: [--canonical] [--cache-dir=<dir>] [--cache-size=<bytes>]"
+    " [--dont-care=<output>] [--dont-care-mode=auto|clique|fast] [--threads=<count>]"
+    " [--affinity=none|compact|spread] [--algorithm=auto|iterative|hopcroft|parallel|brzozowski] [--stats] [--trace=<file>]"
+    " [--max-request-size=<bytes>] [--max-connections=<count>]";
 
 enum class Automata
 {
@@ -11,34 +47,192 @@ enum class Automata
     Moore
 };
 
+enum class Command
+{
+    Minimize,
+    Product,
+    Series,
+    Batch,
+    Serve
+};
+
 struct Args
 {
+    Command command = Command::Minimize;
     Automata automata;
     std::string inputFilename;
+    std::string secondInputFilename;
     std::string outputFilename;
+    // batch inputs, every result goes to the output directory under the file name of its input,
+    // so the output directory must not be the directory of an input
+    std::vector<std::string> inputFilenames;
+    std::string outputDirectory;
+    std::string socketPath;
+    bool canonical = false;
+    std::string cacheDirectory;
+    uintmax_t cacheSize = 256 * 1024 * 1024;
+    std::optional<std::string> dontCareOutput;
+    DontCarePartition::Mode dontCareMode = DontCarePartition::Mode::Auto;
+    unsigned threadsCount = 0;
+    WorkerPool::Affinity affinity = WorkerPool::Affinity::None;
+    PartitionAlgorithm::Algorithm algorithm = PartitionAlgorithm::Algorithm::Auto;
+    bool stats = false;
+    // Chrome trace-event JSON of the minimization phases
+    std::string traceFilename;
+    // server: requests with a larger CSV body are refused
+    uintmax_t maxRequestSize = 256 * 1024 * 1024;
+    // server: connections served at once, further clients wait in the listen backlog
+    size_t maxConnections = 64;
 };
 
-inline Args ParseArgs(const int argc, char** argv)
+inline uintmax_t ParseSizeOption(const std::string& option, const std::string& value)
 {
-    if (argc != 4)
+    try
+    {
+        size_t pos = 0;
+        const auto size = std::stoull(value, &pos);
+        if (pos == value.size())
+        {
+            return size;
+        }
+    }
+    catch (const std::logic_error&)
     {
-        throw std::invalid_argument("Invalid number of arguments. Must be: <automata> <inputFilename> <outputFilename>");
     }
 
-    Automata automata;
+    throw std::invalid_argument("Invalid value of option " + option + value);
+}
+
+inline Automata ParseAutomata(const std::string& automata)
+{
+    if (automata == MEALY)
+    {
+        return Automata::Mealy;
+    }
+    if (automata == MOORE)
+    {
+        return Automata::Moore;
+    }
+
+    throw std::invalid_argument("Invalid automata");
+}
 
-    if (argv[1] == MEALY)
+// Returns false if the argument is not an option
+inline bool ParseOption(Args& args, const std::string& argument)
+{
+    if (argument == CANONICAL_OPTION)
     {
-        automata = Automata::Mealy;
+        args.canonical = true;
     }
-    else if (argv[1] == MOORE)
+    else if (argument.starts_with(CACHE_DIR_OPTION))
     {
-        automata = Automata::Moore;
+        args.cacheDirectory = argument.substr(CACHE_DIR_OPTION.size());
+    }
+    else if (argument.starts_with(CACHE_SIZE_OPTION))
+    {
+        args.cacheSize = ParseSizeOption(CACHE_SIZE_OPTION, argument.substr(CACHE_SIZE_OPTION.size()));
+    }
+    else if (argument.starts_with(DONT_CARE_OPTION))
+    {
+        args.dontCareOutput = argument.substr(DONT_CARE_OPTION.size());
+    }
+    else if (argument.starts_with(DONT_CARE_MODE_OPTION))
+    {
+        args.dontCareMode = DontCarePartition::ParseMode(argument.substr(DONT_CARE_MODE_OPTION.size()));
+    }
+    else if (argument.starts_with(THREADS_OPTION))
+    {
+        args.threadsCount = static_cast<unsigned>(
+            ParseSizeOption(THREADS_OPTION, argument.substr(THREADS_OPTION.size())));
+    }
+    else if (argument.starts_with(AFFINITY_OPTION))
+    {
+        args.affinity = WorkerPool::ParseAffinity(argument.substr(AFFINITY_OPTION.size()));
+    }
+    else if (argument.starts_with(ALGORITHM_OPTION))
+    {
+        args.algorithm = PartitionAlgorithm::ParseAlgorithm(argument.substr(ALGORITHM_OPTION.size()));
+    }
+    else if (argument == STATS_OPTION)
+    {
+        args.stats = true;
+    }
+    else if (argument.starts_with(TRACE_OPTION))
+    {
+        args.traceFilename = argument.substr(TRACE_OPTION.size());
+    }
+    else if (argument.starts_with(MAX_REQUEST_SIZE_OPTION))
+    {
+        args.maxRequestSize = ParseSizeOption(MAX_REQUEST_SIZE_OPTION,
+            argument.substr(MAX_REQUEST_SIZE_OPTION.size()));
+    }
+    else if (argument.starts_with(MAX_CONNECTIONS_OPTION))
+    {
+        args.maxConnections = std::max<uintmax_t>(1,
+            ParseSizeOption(MAX_CONNECTIONS_OPTION, argument.substr(MAX_CONNECTIONS_OPTION.size())));
+    }
+    else if (argument.starts_with("--"))
+    {
+        throw std::invalid_argument("Unknown option " + argument);
     }
     else
     {
-        throw std::invalid_argument("Invalid automata");
+        return false;
+    }
+
+    return true;
+}
+
+inline Args ParseArgs(const int argc, char** argv)
+{
+    Args args {};
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string argument = argv[i]; !ParseOption(args, argument))
+        {
+            positional.push_back(argument);
+        }
     }
 
-    return { automata, argv[2], argv[3] };
+    if (positional.size() == 2 && positional[0] == SERVE)
+    {
+        args.command = Command::Serve;
+        args.socketPath = positional[1];
+
+        return args;
+    }
+
+    if (positional.size() == 4 && (positional[0] == PRODUCT || positional[0] == SERIES))
+    {
+        args.command = positional[0] == PRODUCT ? Command::Product : Command::Series;
+        args.automata = Automata::Mealy;
+        args.inputFilename = positional[1];
+        args.secondInputFilename = positional[2];
+        args.outputFilename = positional[3];
+
+        return args;
+    }
+
+    if (positional.size() >= 4 && positional[0] == BATCH)
+    {
+        args.command = Command::Batch;
+        args.automata = ParseAutomata(positional[1]);
+        args.outputDirectory = positional[2];
+        args.inputFilenames.assign(positional.begin() + 3, positional.end());
+
+        return args;
+    }
+
+    if (positional.size() != 3)
+    {
+        throw std::invalid_argument("Invalid number of arguments. " + USAGE);
+    }
+
+    args.automata = ParseAutomata(positional[0]);
+    args.inputFilename = positional[1];
+    args.outputFilename = positional[2];
+
+    return args;
 }
@@ -0,0 +1,494 @@
+#pragma once
+#ifndef AUTOMATA_TABLE_H
+#define AUTOMATA_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SparseTransitionTable.h"
+#include "../Utils/SimdRows.h"
+
+using State = std::string;
+using InputSymbol = std::string;
+using OutputSymbol = std::string;
+
+// Input symbols in table order, each with the index of its input class
+using InputClasses = std::vector<std::pair<InputSymbol, uint32_t>>;
+
+// Hash of string keys that also looks up string_view, so names are resolved without copying them
+struct NameHash
+{
+    using is_transparent = void;
+
+    size_t operator()(const std::string_view name) const
+    {
+        return std::hash<std::string_view>{}(name);
+    }
+};
+
+using NameIndexes = std::unordered_map<std::string, uint32_t, NameHash, std::equal_to<>>;
+
+// A defined transition in the column of an input: the state, the state it goes to and, in a Mealy table, its output id
+struct TransitionCell
+{
+    uint32_t state;
+    uint32_t target;
+    uint32_t output;
+
+    bool operator==(const TransitionCell& other) const = default;
+};
+
+static_assert(sizeof(TransitionCell) == 3 * sizeof(uint32_t), "columns are hashed as arrays of uint32_t");
+
+using TransitionColumn = std::vector<TransitionCell>;
+
+// Distinct columns of a table: an input whose column equals an earlier one gets the class of that one,
+// so an alphabet of many symbols that act alike costs a few columns
+class ColumnClasses
+{
+public:
+    uint32_t Add(TransitionColumn column)
+    {
+        const auto hash = SimdRows::Hash(reinterpret_cast<const uint32_t*>(column.data()), column.size() * 3);
+        auto [begin, end] = m_classesByHash.equal_range(hash);
+        for (auto it = begin; it != end; ++it)
+        {
+            if (m_columns[it->second] == column)
+            {
+                return it->second;
+            }
+        }
+
+        const auto inputClass = static_cast<uint32_t>(m_columns.size());
+        m_classesByHash.emplace(hash, inputClass);
+        m_columns.push_back(std::move(column));
+        return inputClass;
+    }
+
+    [[nodiscard]] uint32_t GetClassesCount() const
+    {
+        return static_cast<uint32_t>(m_columns.size());
+    }
+
+    // Rows by state of the distinct columns, ordered by class. Output ids are kept only if withOutputs
+    void Build(const size_t statesCount, const bool withOutputs, SparseTransitionTable& transitions,
+        std::vector<uint32_t>& outputs) const
+    {
+        transitions.rowOffsets.assign(statesCount + 1, 0);
+        for (auto& column: m_columns)
+        {
+            for (auto& cell: column)
+            {
+                ++transitions.rowOffsets[cell.state + 1];
+            }
+        }
+        for (size_t state = 0; state < statesCount; ++state)
+        {
+            transitions.rowOffsets[state + 1] += transitions.rowOffsets[state];
+        }
+
+        const size_t transitionsCount = transitions.rowOffsets.back();
+        transitions.inputs.resize(transitionsCount);
+        transitions.targets.resize(transitionsCount);
+        outputs.assign(withOutputs ? transitionsCount : 0, 0);
+
+        std::vector<uint32_t> positions(transitions.rowOffsets.begin(), transitions.rowOffsets.end() - 1);
+        for (uint32_t inputClass = 0; inputClass < m_columns.size(); ++inputClass)
+        {
+            for (auto& cell: m_columns[inputClass])
+            {
+                const uint32_t pos = positions[cell.state]++;
+                transitions.inputs[pos] = inputClass;
+                transitions.targets[pos] = cell.target;
+                if (withOutputs)
+                {
+                    outputs[pos] = cell.output;
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<TransitionColumn> m_columns;
+    std::unordered_multimap<uint64_t, uint32_t> m_classesByHash;
+};
+
+// Table of an automata that keeps only its defined transitions, so a partial automata costs its transitions,
+// not states * inputs. Transitions of a state are a row of the CSR table ordered by input class.
+// A Mealy table has an output id per transition, a Moore table one per state
+struct AutomataTable
+{
+    static constexpr char NEW_STATE_CHAR = 'X';
+    static constexpr uint32_t NO_TRANSITION = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t NO_OUTPUT = std::numeric_limits<uint32_t>::max();
+
+    std::vector<State> states;
+    // Moore: output id of every state
+    std::vector<uint32_t> stateOutputs;
+    // inputs are input classes
+    SparseTransitionTable transitions;
+    // Mealy: output id of every transition, aligned with transitions.targets
+    std::vector<uint32_t> transitionOutputs;
+    InputClasses inputs;
+    uint32_t classesCount = 0;
+    std::vector<OutputSymbol> outputSymbols;
+
+    // Id of the output symbol, NO_OUTPUT if no state or transition outputs it
+    [[nodiscard]] uint32_t FindOutput(const OutputSymbol& output) const
+    {
+        const auto it = std::ranges::find(outputSymbols, output);
+        return it != outputSymbols.end() ? static_cast<uint32_t>(it - outputSymbols.begin()) : NO_OUTPUT;
+    }
+
+    // Index of the transition of the state on the input class, NO_TRANSITION if it is undefined
+    [[nodiscard]] uint32_t FindTransition(const uint32_t state, const uint32_t inputClass) const
+    {
+        const auto begin = transitions.inputs.begin() + transitions.rowOffsets[state];
+        const auto end = transitions.inputs.begin() + transitions.rowOffsets[state + 1];
+        const auto it = std::lower_bound(begin, end, inputClass);
+
+        return it != end && *it == inputClass
+            ? static_cast<uint32_t>(it - transitions.inputs.begin())
+            : NO_TRANSITION;
+    }
+
+    // Defined transitions of every input class in state order
+    [[nodiscard]] std::vector<TransitionColumn> GetColumns() const
+    {
+        std::vector<TransitionColumn> columns(classesCount);
+        for (uint32_t state = 0; state < states.size(); ++state)
+        {
+            for (auto i = transitions.rowOffsets[state]; i < transitions.rowOffsets[state + 1]; ++i)
+            {
+                columns[transitions.inputs[i]].push_back(
+                    { state, transitions.targets[i], transitionOutputs.empty() ? 0 : transitionOutputs[i] });
+            }
+        }
+
+        return columns;
+    }
+
+    // Classes whose columns became equal, when states were removed or merged, share one column again
+    void MergeEqualClasses()
+    {
+        ColumnClasses classes;
+        std::vector<uint32_t> newClasses;
+        for (auto& column: GetColumns())
+        {
+            newClasses.push_back(classes.Add(std::move(column)));
+        }
+        if (classes.GetClassesCount() == classesCount)
+        {
+            return;
+        }
+
+        classes.Build(states.size(), !transitionOutputs.empty(), transitions, transitionOutputs);
+        for (auto& [inputSymbol, inputClass]: inputs)
+        {
+            inputClass = newClasses[inputClass];
+        }
+        classesCount = classes.GetClassesCount();
+    }
+
+    // Keeps the states reachable from the start state, state 0
+    void RemoveUnreachableStates()
+    {
+        if (states.empty())
+        {
+            return;
+        }
+
+        std::vector<uint32_t> newIndexes(states.size(), NO_TRANSITION);
+        std::vector<uint32_t> order = { 0 };
+        newIndexes[0] = 0;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            for (auto j = transitions.rowOffsets[order[i]]; j < transitions.rowOffsets[order[i] + 1]; ++j)
+            {
+                const uint32_t target = transitions.targets[j];
+                if (newIndexes[target] == NO_TRANSITION)
+                {
+                    newIndexes[target] = 0;
+                    order.push_back(target);
+                }
+            }
+        }
+        if (order.size() == states.size())
+        {
+            return;
+        }
+
+        // the kept states stay in table order, so only the columns of removed states change
+        std::vector<uint32_t> kept;
+        for (uint32_t state = 0; state < states.size(); ++state)
+        {
+            if (newIndexes[state] != NO_TRANSITION)
+            {
+                newIndexes[state] = static_cast<uint32_t>(kept.size());
+                kept.push_back(state);
+            }
+        }
+        *this = GetSubtable(kept, newIndexes);
+        MergeEqualClasses();
+    }
+
+    // Transitions the refinement has to follow: input classes where every state loops to itself never
+    // separate states by their successors and are left out, the others are numbered densely
+    [[nodiscard]] SparseTransitionTable GetRefinementTable(WorkerPool* pool) const
+    {
+        std::vector<size_t> selfLoopsCounts(classesCount, 0);
+        for (uint32_t state = 0; state < states.size(); ++state)
+        {
+            for (auto i = transitions.rowOffsets[state]; i < transitions.rowOffsets[state + 1]; ++i)
+            {
+                if (transitions.targets[i] == state)
+                {
+                    ++selfLoopsCounts[transitions.inputs[i]];
+                }
+            }
+        }
+
+        std::vector<uint32_t> refinedInputs(classesCount, NO_TRANSITION);
+        uint32_t refinedInputsCount = 0;
+        for (uint32_t inputClass = 0; inputClass < classesCount; ++inputClass)
+        {
+            if (selfLoopsCounts[inputClass] != states.size())
+            {
+                refinedInputs[inputClass] = refinedInputsCount++;
+            }
+        }
+
+        return SparseTransitionTable::Build(states.size(), pool, [&](const size_t state, auto&& add) {
+            for (auto i = transitions.rowOffsets[state]; i < transitions.rowOffsets[state + 1]; ++i)
+            {
+                if (refinedInputs[transitions.inputs[i]] != NO_TRANSITION)
+                {
+                    add(refinedInputs[transitions.inputs[i]], transitions.targets[i]);
+                }
+            }
+        });
+    }
+
+    // One state X<i> per block, representatives[i] gives its transitions and outputs
+    [[nodiscard]] AutomataTable GetQuotient(const std::vector<uint32_t>& blocks,
+        const std::vector<uint32_t>& newIndexes, const std::vector<uint32_t>& representatives) const
+    {
+        std::vector<uint32_t> stateIndexes(states.size());
+        for (uint32_t state = 0; state < states.size(); ++state)
+        {
+            stateIndexes[state] = newIndexes[blocks[state]];
+        }
+
+        return GetSubtable(representatives, stateIndexes, true);
+    }
+
+    // Input symbols are sorted, the classes are numbered in order of their first symbol, and the states
+    // reachable from the start state are renamed X0..Xn in BFS order over the classes,
+    // so that equivalent automata give textually equal tables
+    [[nodiscard]] AutomataTable GetCanonical() const
+    {
+        if (states.empty())
+        {
+            return *this;
+        }
+
+        InputClasses sortedInputs = inputs;
+        std::ranges::stable_sort(sortedInputs, {}, [](const auto& input) { return input.first; });
+        std::vector<uint32_t> newClasses(classesCount, NO_TRANSITION);
+        uint32_t newClassesCount = 0;
+        for (auto& [inputSymbol, inputClass]: sortedInputs)
+        {
+            if (newClasses[inputClass] == NO_TRANSITION)
+            {
+                newClasses[inputClass] = newClassesCount++;
+            }
+            inputClass = newClasses[inputClass];
+        }
+
+        // a state's row is written when BFS reaches it, so new state i gets row i
+        AutomataTable canonical;
+        canonical.inputs = std::move(sortedInputs);
+        canonical.classesCount = classesCount;
+        canonical.outputSymbols = outputSymbols;
+        std::vector<uint32_t> newIndexes(states.size(), NO_TRANSITION);
+        std::vector<uint32_t> order = { 0 };
+        newIndexes[0] = 0;
+        std::vector<std::pair<uint32_t, uint32_t>> row;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const uint32_t state = order[i];
+            row.clear();
+            for (auto j = transitions.rowOffsets[state]; j < transitions.rowOffsets[state + 1]; ++j)
+            {
+                row.emplace_back(newClasses[transitions.inputs[j]], j);
+            }
+            std::ranges::sort(row);
+
+            for (auto [inputClass, j]: row)
+            {
+                const uint32_t target = transitions.targets[j];
+                if (newIndexes[target] == NO_TRANSITION)
+                {
+                    newIndexes[target] = static_cast<uint32_t>(order.size());
+                    order.push_back(target);
+                }
+                canonical.transitions.inputs.push_back(inputClass);
+                canonical.transitions.targets.push_back(newIndexes[target]);
+                if (!transitionOutputs.empty())
+                {
+                    canonical.transitionOutputs.push_back(transitionOutputs[j]);
+                }
+            }
+            canonical.transitions.rowOffsets.push_back(static_cast<uint32_t>(canonical.transitions.targets.size()));
+        }
+
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            canonical.states.push_back(NEW_STATE_CHAR + std::to_string(i));
+            if (!stateOutputs.empty())
+            {
+                canonical.stateOutputs.push_back(stateOutputs[order[i]]);
+            }
+        }
+
+        return canonical;
+    }
+
+    // A line per input symbol with a cell per state, writeCell(line, cell) appends a defined transition
+    template <typename WriteCell>
+    void WriteRows(std::ostream& output, WriteCell&& writeCell) const
+    {
+        const auto columns = GetColumns();
+        std::string line;
+        for (const auto& [inputSymbol, inputClass]: inputs)
+        {
+            line = inputSymbol;
+            auto cell = columns[inputClass].begin();
+            for (uint32_t state = 0; state < states.size(); ++state)
+            {
+                line += ';';
+                if (cell != columns[inputClass].end() && cell->state == state)
+                {
+                    writeCell(line, *cell++);
+                }
+            }
+            line += '\n';
+            output << line;
+        }
+    }
+
+private:
+    // Table of the given states, new state i is kept[i] renamed by stateIndexes.
+    // With rename the states are named X<i>, otherwise they keep their names
+    [[nodiscard]] AutomataTable GetSubtable(const std::vector<uint32_t>& kept,
+        const std::vector<uint32_t>& stateIndexes, const bool rename = false) const
+    {
+        AutomataTable subtable;
+        subtable.inputs = inputs;
+        subtable.classesCount = classesCount;
+        subtable.outputSymbols = outputSymbols;
+        for (size_t i = 0; i < kept.size(); ++i)
+        {
+            const uint32_t state = kept[i];
+            subtable.states.push_back(rename ? NEW_STATE_CHAR + std::to_string(i) : states[state]);
+            if (!stateOutputs.empty())
+            {
+                subtable.stateOutputs.push_back(stateOutputs[state]);
+            }
+            for (auto j = transitions.rowOffsets[state]; j < transitions.rowOffsets[state + 1]; ++j)
+            {
+                subtable.transitions.inputs.push_back(transitions.inputs[j]);
+                subtable.transitions.targets.push_back(stateIndexes[transitions.targets[j]]);
+                if (!transitionOutputs.empty())
+                {
+                    subtable.transitionOutputs.push_back(transitionOutputs[j]);
+                }
+            }
+            subtable.transitions.rowOffsets.push_back(static_cast<uint32_t>(subtable.transitions.targets.size()));
+        }
+
+        return subtable;
+    }
+};
+
+// Collects a table one input symbol at a time, as the CSV gives it: a column per input symbol
+class AutomataTableBuilder
+{
+public:
+    // States are numbered in this order, a state named twice keeps its first index
+    explicit AutomataTableBuilder(std::vector<State> states)
+    {
+        for (uint32_t i = 0; i < states.size(); ++i)
+        {
+            m_stateIndexes.emplace(states[i], i);
+        }
+        m_table.states = std::move(states);
+    }
+
+    [[nodiscard]] size_t GetStatesCount() const
+    {
+        return m_table.states.size();
+    }
+
+    [[nodiscard]] uint32_t GetStateIndex(const std::string_view state) const
+    {
+        const auto it = m_stateIndexes.find(state);
+        if (it == m_stateIndexes.end())
+        {
+            throw std::invalid_argument("Transition to unknown state " + std::string(state));
+        }
+
+        return it->second;
+    }
+
+    uint32_t GetOutputId(const std::string_view output)
+    {
+        auto it = m_outputIds.find(output);
+        if (it == m_outputIds.end())
+        {
+            it = m_outputIds.emplace(std::string(output), static_cast<uint32_t>(m_table.outputSymbols.size())).first;
+            m_table.outputSymbols.emplace_back(output);
+        }
+
+        return it->second;
+    }
+
+    // Moore: the output of the next state in table order
+    void AddStateOutput(const std::string_view output)
+    {
+        m_table.stateOutputs.push_back(GetOutputId(output));
+    }
+
+    // The defined transitions of an input symbol in state order
+    void AddInput(InputSymbol inputSymbol, TransitionColumn column)
+    {
+        m_table.inputs.emplace_back(std::move(inputSymbol), m_classes.Add(std::move(column)));
+    }
+
+    // Mealy tables keep the output ids of the transitions
+    [[nodiscard]] AutomataTable Release(const bool isMealy)
+    {
+        m_classes.Build(m_table.states.size(), isMealy, m_table.transitions, m_table.transitionOutputs);
+        m_table.classesCount = m_classes.GetClassesCount();
+        m_stateIndexes.clear();
+        m_outputIds.clear();
+
+        return std::move(m_table);
+    }
+
+private:
+    AutomataTable m_table;
+    ColumnClasses m_classes;
+    NameIndexes m_stateIndexes;
+    NameIndexes m_outputIds;
+};
+
+#endif
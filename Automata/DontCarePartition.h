@@ -0,0 +1,279 @@
+#pragma once
+#ifndef DONT_CARE_PARTITION_H
+#define DONT_CARE_PARTITION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SparseTransitionTable.h"
+
+// Initial partitions for incompletely specified automata where some outputs are "don't care".
+// Every block returned here consists of pairwise compatible states, SparsePartition::Refine then only
+// splits blocks, so the result is a closed cover and the merged automata reproduces every specified output
+namespace DontCarePartition
+{
+    enum class Mode
+    {
+        Auto,
+        Clique,
+        Fast
+    };
+
+    // the pair table of the clique mode is a bit per pair, statesCount^2 / 16 bytes (1 MiB at the limit),
+    // so the limit is set by its O(inputs * statesCount^2) time
+    constexpr size_t CLIQUE_STATES_LIMIT = 4096;
+
+    inline Mode ParseMode(const std::string& mode)
+    {
+        if (mode == "auto")
+        {
+            return Mode::Auto;
+        }
+        if (mode == "clique")
+        {
+            return Mode::Clique;
+        }
+        if (mode == "fast")
+        {
+            return Mode::Fast;
+        }
+
+        throw std::invalid_argument("Invalid don't care mode " + mode);
+    }
+
+    class CompatibilityTable
+    {
+    public:
+        explicit CompatibilityTable(const size_t statesCount)
+            : m_incompatible(statesCount * (statesCount - 1) / 2, false)
+        {}
+
+        [[nodiscard]] bool IsCompatible(const uint32_t first, const uint32_t second) const
+        {
+            return first == second || !m_incompatible[GetIndex(first, second)];
+        }
+
+        // returns false if the pair was already marked
+        bool MarkIncompatible(const uint32_t first, const uint32_t second)
+        {
+            const size_t index = GetIndex(first, second);
+            if (m_incompatible[index])
+            {
+                return false;
+            }
+            m_incompatible[index] = true;
+
+            return true;
+        }
+
+    private:
+        static size_t GetIndex(uint32_t first, uint32_t second)
+        {
+            if (first < second)
+            {
+                std::swap(first, second);
+            }
+
+            return static_cast<size_t>(first) * (first - 1) / 2 + second;
+        }
+
+        std::vector<bool> m_incompatible;
+    };
+
+    // Output ids of the states by slot, stored like SparseTransitionTable: the slots of a state are
+    // [offsets[state], offsets[state + 1]) in increasing order. A Mealy state has a slot per defined input class,
+    // a Moore state a single one
+    struct SlotOutputs
+    {
+        StateArray offsets = { 0 };
+        StateArray slots;
+        std::vector<uint32_t> outputs;
+    };
+
+    // States are compatible on outputs if they have the same slots and every slot has equal outputs or a wildcard
+    inline bool AreOutputsCompatible(const SlotOutputs& outputs, const uint32_t wildcard,
+        const uint32_t first, const uint32_t second)
+    {
+        auto i = outputs.offsets[first];
+        auto j = outputs.offsets[second];
+        if (outputs.offsets[first + 1] - i != outputs.offsets[second + 1] - j)
+        {
+            return false;
+        }
+
+        for (; i < outputs.offsets[first + 1]; ++i, ++j)
+        {
+            const uint32_t firstOutput = outputs.outputs[i];
+            const uint32_t secondOutput = outputs.outputs[j];
+            if (outputs.slots[i] != outputs.slots[j]
+                || (firstOutput != secondOutput && firstOutput != wildcard && secondOutput != wildcard))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    inline bool HaveSameInputs(const SparseTransitionTable& table, const uint32_t first, const uint32_t second)
+    {
+        return std::equal(
+            table.inputs.begin() + table.rowOffsets[first], table.inputs.begin() + table.rowOffsets[first + 1],
+            table.inputs.begin() + table.rowOffsets[second], table.inputs.begin() + table.rowOffsets[second + 1]);
+    }
+
+    // Two states are incompatible if their specified outputs or their defined inputs differ,
+    // or some input leads them to incompatible states
+    inline CompatibilityTable GetCompatibilityTable(const SparseTransitionTable& table,
+        const SlotOutputs& outputs, const uint32_t wildcard)
+    {
+        const auto statesCount = static_cast<uint32_t>(table.GetStatesCount());
+        const auto reversed = table.GetReversed();
+
+        CompatibilityTable compatibility(statesCount);
+        std::vector<std::pair<uint32_t, uint32_t>> worklist;
+
+        for (uint32_t first = 1; first < statesCount; ++first)
+        {
+            for (uint32_t second = 0; second < first; ++second)
+            {
+                if (!AreOutputsCompatible(outputs, wildcard, first, second)
+                    || !HaveSameInputs(table, first, second))
+                {
+                    compatibility.MarkIncompatible(first, second);
+                    worklist.emplace_back(first, second);
+                }
+            }
+        }
+
+        while (!worklist.empty())
+        {
+            auto [first, second] = worklist.back();
+            worklist.pop_back();
+
+            // walk both predecessor lists by input, every pair of predecessors on one input becomes incompatible
+            auto i = reversed.rowOffsets[first];
+            auto j = reversed.rowOffsets[second];
+            while (i < reversed.rowOffsets[first + 1] && j < reversed.rowOffsets[second + 1])
+            {
+                if (reversed.inputs[i] != reversed.inputs[j])
+                {
+                    reversed.inputs[i] < reversed.inputs[j] ? ++i : ++j;
+                    continue;
+                }
+
+                const uint32_t input = reversed.inputs[i];
+                const auto secondBegin = j;
+                for (; i < reversed.rowOffsets[first + 1] && reversed.inputs[i] == input; ++i)
+                {
+                    for (j = secondBegin; j < reversed.rowOffsets[second + 1] && reversed.inputs[j] == input; ++j)
+                    {
+                        const uint32_t firstSource = reversed.targets[i];
+                        const uint32_t secondSource = reversed.targets[j];
+                        if (firstSource != secondSource && compatibility.MarkIncompatible(firstSource, secondSource))
+                        {
+                            worklist.emplace_back(firstSource, secondSource);
+                        }
+                    }
+                }
+            }
+        }
+
+        return compatibility;
+    }
+
+    // Greedy clique cover of the compatibility graph: every state joins the first block it is compatible with
+    inline std::vector<uint32_t> GetCliqueBlocks(const SparseTransitionTable& table,
+        const SlotOutputs& outputs, const uint32_t wildcard)
+    {
+        const auto statesCount = static_cast<uint32_t>(table.GetStatesCount());
+        const auto compatibility = GetCompatibilityTable(table, outputs, wildcard);
+
+        std::vector<std::vector<uint32_t>> cliques;
+        std::vector<uint32_t> blocks(statesCount);
+
+        for (uint32_t state = 0; state < statesCount; ++state)
+        {
+            auto clique = std::ranges::find_if(cliques, [&](auto& members) {
+                return std::ranges::all_of(members, [&](const uint32_t member) {
+                    return compatibility.IsCompatible(state, member);
+                });
+            });
+
+            if (clique == cliques.end())
+            {
+                clique = cliques.emplace(cliques.end());
+            }
+            clique->push_back(state);
+            blocks[state] = static_cast<uint32_t>(clique - cliques.begin());
+        }
+
+        return blocks;
+    }
+
+    // Linear fallback for large automata: every don't care becomes the most frequent output of its slot
+    inline std::vector<uint32_t> GetFilledBlocks(const size_t statesCount, const SlotOutputs& outputs,
+        const uint32_t wildcard)
+    {
+        const size_t slotsCount = outputs.slots.empty() ? 0 : *std::ranges::max_element(outputs.slots) + 1;
+        std::vector<std::map<uint32_t, size_t>> frequencies(slotsCount);
+        for (size_t i = 0; i < outputs.outputs.size(); ++i)
+        {
+            if (outputs.outputs[i] != wildcard)
+            {
+                ++frequencies[outputs.slots[i]][outputs.outputs[i]];
+            }
+        }
+
+        std::vector<uint32_t> mostFrequent(slotsCount, wildcard);
+        for (size_t slot = 0; slot < slotsCount; ++slot)
+        {
+            if (!frequencies[slot].empty())
+            {
+                mostFrequent[slot] = std::ranges::max_element(frequencies[slot], {}, [](auto& it) {
+                    return it.second;
+                })->first;
+            }
+        }
+
+        // a block per distinct list of (slot, filled output) pairs
+        std::map<std::vector<uint32_t>, uint32_t> outputsToBlock;
+        std::vector<uint32_t> blocks;
+        std::vector<uint32_t> stateOutputs;
+        for (size_t state = 0; state < statesCount; ++state)
+        {
+            stateOutputs.clear();
+            for (auto i = outputs.offsets[state]; i < outputs.offsets[state + 1]; ++i)
+            {
+                const uint32_t slot = outputs.slots[i];
+                stateOutputs.push_back(slot);
+                stateOutputs.push_back(outputs.outputs[i] == wildcard ? mostFrequent[slot] : outputs.outputs[i]);
+            }
+            auto [it, _] = outputsToBlock.emplace(stateOutputs, static_cast<uint32_t>(outputsToBlock.size()));
+            blocks.push_back(it->second);
+        }
+
+        return blocks;
+    }
+
+    // wildcard is the id of the don't care output
+    inline std::vector<uint32_t> GetInitialBlocks(const SparseTransitionTable& table,
+        const SlotOutputs& outputs, const uint32_t wildcard, Mode mode)
+    {
+        const size_t statesCount = table.GetStatesCount();
+        if (mode == Mode::Auto)
+        {
+            mode = statesCount <= CLIQUE_STATES_LIMIT ? Mode::Clique : Mode::Fast;
+        }
+
+        return mode == Mode::Clique
+            ? GetCliqueBlocks(table, outputs, wildcard)
+            : GetFilledBlocks(statesCount, outputs, wildcard);
+    }
+}
+
+#endif
@@ -1,77 +1,51 @@
 #pragma once
-#include <memory>
+#include <chrono>
+#include <ostream>
 #include <string>
 
-using State = std::string;
-using InputSymbol = std::string;
-using OutputSymbol = std::string;
+#include "AutomataTable.h"
+#include "DontCarePartition.h"
+#include "PartitionAlgorithm.h"
+#include "../Utils/WorkerPool.h"
 
-struct Transition
+inline double GetMilliseconds(const std::chrono::steady_clock::time_point begin,
+    const std::chrono::steady_clock::time_point end)
 {
-    Transition(std::string& nextState, std::string& output)
-        : nextState(nextState),
-        output(output)
-    {}
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
 
-    std::string nextState;
-    std::string output;
-
-    bool operator<(const Transition& other) const
-    {
-        if (nextState != other.nextState)
-        {
-            return nextState < other.nextState;
-        }
-        return output < other.output;
-    }
-};
-
-class Group
+class IAutomata
 {
 public:
-    void AddState(const std::string& state)
-    {
-        m_states.emplace(state);
-    }
+    virtual void ExportToCsv(const std::string& filename) const = 0;
 
-    void RemoveState(const std::string& state)
-    {
-        if (m_states.contains(state))
-        {
-            m_states.erase(state);
-        }
-    }
+    virtual void WriteCsv(std::ostream& output) const = 0;
 
-    [[nodiscard]] std::set<std::string> GetStates() const
-    {
-        return m_states;
-    }
+    [[nodiscard]] virtual size_t GetStatesCount() const = 0;
 
-    [[nodiscard]] size_t GetStatesCount() const
-    {
-        return m_states.size();
-    }
+    // Parallel phases of minimization run on the pool, without one everything runs on the calling thread.
+    // The pool is not owned and must outlive the minimization
+    virtual void SetWorkerPool(WorkerPool* pool) = 0;
 
-    std::string GetMainState()
-    {
-        for (auto& state : m_states)
-        {
-            return state;
-        }
+    // Merges equivalent states with the given partition refinement engine, Auto picks one from the table.
+    // Returns the statistics the choice was made from, the chosen engine and its timings
+    virtual PartitionAlgorithm::Stats Minimize(PartitionAlgorithm::Algorithm algorithm) = 0;
 
-        throw std::runtime_error("No state found");
+    PartitionAlgorithm::Stats Minimize()
+    {
+        return Minimize(PartitionAlgorithm::Algorithm::Auto);
     }
 
-private:
-    std::set<std::string> m_states {};
-};
+    // Minimization of an incompletely specified automata: states may merge if their outputs differ
+    // only where one of them outputs wildcard. The result is small but not necessarily minimal
+    virtual void MinimizeWithDontCare(const OutputSymbol& wildcard, DontCarePartition::Mode mode) = 0;
 
-class IAutomata
-{
-public:
-    virtual void ExportToCsv(const std::string& filename) const = 0;
+    // Renames states to X0..Xn in BFS order from the start state over sorted input symbols,
+    // so that equivalent automata give textually equal tables
+    virtual void Canonicalize() = 0;
 
-    virtual void Minimize() = 0;
+    // SHA-256 of the canonical table, does not modify the automata
+    [[nodiscard]] virtual std::string GetCanonicalHash() const = 0;
 
     virtual ~IAutomata() = default;
 };
\ No newline at end of file
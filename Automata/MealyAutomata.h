@@ -2,19 +2,21 @@
 #ifndef MEALY_AUTOMATA_H
 #define MEALY_AUTOMATA_H
 
-#include <algorithm>
+#include <chrono>
 #include <fstream>
-#include <list>
 #include <map>
-#include <queue>
-#include <set>
+#include <sstream>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "AutomataTable.h"
 #include "IAutomata.h"
-
-using MealyTransitionTable = std::list<std::pair<InputSymbol, std::vector<Transition>>>;
-using MealyStates = std::vector<std::string>;
+#include "PartitionAlgorithm.h"
+#include "SparseTransitionTable.h"
+#include "../Utils/CompressedIo.h"
+#include "../Utils/Sha256.h"
+#include "../Utils/Trace.h"
 
 class MealyAutomata final : public IAutomata
 {
@@ -22,363 +24,218 @@ public:
     static constexpr char STATE_CHAR = 'X';
     static constexpr size_t FIRST_STATE_INDEX = 1;
 
-    MealyAutomata(MealyStates states, MealyTransitionTable table)
-        : m_states(std::move(states)),
-        m_transitionTable(std::move(table))
+    // A table with an output id per transition, as AutomataTableBuilder::Release(true) gives it
+    explicit MealyAutomata(AutomataTable table)
+        : m_table(std::move(table))
     {}
 
-    void ExportToCsv(const std::string &filename) const override
+    // Defined transitions by state over classes of input symbols, inputs gives the class of every symbol
+    [[nodiscard]] const AutomataTable& GetTable() const
     {
-        std::ofstream output(filename);
-        if (!output.is_open())
-        {
-            const std::string message = "Could not open file " + filename + " for writing";
-            throw std::invalid_argument(message);
-        }
-
-        for (const auto& state: m_states)
-        {
-            output << ';' << state;
-        }
-        output << std::endl;
-
-        for (const auto& [inputSymbol, transitions] : m_transitionTable)
-        {
-            output << inputSymbol;
-
-            for (const Transition& transition : transitions)
-            {
-                output << ';' << transition.nextState << '/' << transition.output;
-            }
-
-            output << std::endl;
-        }
+        return m_table;
     }
 
-    void Minimize() override
+    // Outputs of the word read from the start state
+    [[nodiscard]] std::vector<OutputSymbol> Simulate(const std::vector<InputSymbol>& word) const
     {
-        RemoveImpossibleState();
+        std::unordered_map<InputSymbol, uint32_t> inputClasses(m_table.inputs.begin(), m_table.inputs.end());
 
-        std::map<State, Group*> stateToGroup;
-        std::map<std::vector<OutputSymbol>, std::vector<Group>> outputToGroup;
-
-        std::map<State, unsigned> stateIndexes;
-        for (unsigned i = 0; auto& state: m_states)
+        std::vector<OutputSymbol> outputs;
+        uint32_t state = 0;
+        for (auto& inputSymbol: word)
         {
-            stateIndexes[state] = i++;
-        }
-
-        InitGroups(stateToGroup, outputToGroup);
-
-        auto statesTransitions = GetStatesTransitions();
-
-        while (true)
-        {
-            bool isChangedSize = false;
-
-            for (auto& pair: outputToGroup)
+            auto inputClass = inputClasses.find(inputSymbol);
+            if (inputClass == inputClasses.end())
             {
-                std::vector<Group> newGroups;
-                for (auto& group: pair.second)
-                {
-                    if (group.GetStatesCount() <= 1)
-                    {
-                        continue;
-                    }
-
-                    std::string mainState = group.GetMainState();
-
-                    std::vector<Group*> mainStateTransitions;
-                    for (auto& it: statesTransitions[mainState])
-                    {
-                        mainStateTransitions.emplace_back(stateToGroup[it]);
-                    }
-
-                    for (auto& state: group.GetStates())
-                    {
-                        if (state == mainState)
-                        {
-                            continue;
-                        }
-
-                        for (unsigned i = 0; auto& it: statesTransitions[state])
-                        {
-                            if (mainStateTransitions.at(i++) != stateToGroup[it])
-                            {
-                                group.RemoveState(state);
-
-                                Group newGroup;
-                                newGroup.AddState(state);
-
-                                newGroups.push_back(newGroup);
-                                stateToGroup[state] = &newGroups.back();
-
-                                break;
-                            }
-                        }
-                    }
-                }
-                for (auto& it: newGroups)
-                {
-                    pair.second.push_back(it);
-                    if (!isChangedSize)
-                    {
-                        isChangedSize = true;
-                    }
-                }
+                throw std::invalid_argument("Unknown input symbol " + inputSymbol);
             }
 
-            if (!isChangedSize)
+            const uint32_t transition = m_table.FindTransition(state, inputClass->second);
+            if (transition == AutomataTable::NO_TRANSITION)
             {
-                break;
+                throw std::runtime_error("No transition from state " + m_table.states[state] + " on " + inputSymbol);
             }
+            outputs.push_back(m_table.outputSymbols[m_table.transitionOutputs[transition]]);
+            state = m_table.transitions.targets[transition];
         }
 
-        BuildMinimizedAutomata(stateToGroup, outputToGroup);
+        return outputs;
     }
 
-private:
-    static constexpr char NEW_STATE_CHAR = 'X';
-    void BuildMinimizedAutomata(std::map<State, Group*>& stateToGroup,
-        std::map<std::vector<OutputSymbol>, std::vector<Group>> outputToGroup)
+    [[nodiscard]] size_t GetStatesCount() const override
     {
-        std::string inputState = m_states.front();
-        MealyStates newStates;
-        std::vector<std::pair<InputSymbol, std::vector<Transition>>> transitionTable;
-        for (auto& row: m_transitionTable)
-        {
-            transitionTable.emplace_back(row.first, std::vector<Transition>());
-        }
-
-        auto newStateNames = GetNewStateNames(outputToGroup);
-
-        auto statesTransitions = GetStatesTransitionsMap();
-
-        for (auto& pair: outputToGroup)
-        {
-            for (auto& group: pair.second)
-            {
-                std::string state = group.GetMainState();
-                std::string newState = newStateNames[state];
-
-                auto transitions = statesTransitions[state];
-                unsigned i = 0;
-                if (state == inputState)
-                {
-                    newStates.emplace(newStates.begin(), newState);
-
-                    for (auto& it: transitions)
-                    {
-                        std::string nextState = newStateNames[it.nextState];
-                        transitionTable.at(i).second.emplace(transitionTable.at(i).second.begin(),
-                                                    nextState, it.output);
-                        ++i;
-                    }
-                }
-                else
-                {
-                    newStates.emplace_back(newState);
+        return m_table.states.size();
+    }
 
-                    for (auto& it: transitions)
-                    {
-                        std::string nextState = newStateNames[it.nextState];
-                        transitionTable.at(i++).second.emplace_back(nextState, it.output);
-                    }
-                }
-            }
-        }
+    void SetWorkerPool(WorkerPool* pool) override
+    {
+        m_workerPool = pool;
+    }
 
-        MealyTransitionTable newTransitionTable;
-        for (auto& it: transitionTable)
+    void ExportToCsv(const std::string &filename) const override
+    {
+        std::ofstream output(filename, std::ios::binary);
+        if (!output.is_open())
         {
-            newTransitionTable.emplace_back(it.first, it.second);
+            const std::string message = "Could not open file " + filename + " for writing";
+            throw std::invalid_argument(message);
         }
 
-        m_states = newStates;
-        m_transitionTable = newTransitionTable;
+        WriteCompressed(output, GetCompressionByExtension(filename), [this](std::ostream& stream) {
+            WriteCsv(stream);
+        });
     }
 
-    std::map<State, std::vector<Transition>> GetStatesTransitionsMap()
+    void WriteCsv(std::ostream& output) const override
     {
-        std::map<State, std::vector<Transition>> statesTransitions;
-        for (unsigned i = 0; auto& state: m_states)
-        {
-            std::vector<Transition> transitions;
-            for (auto& row: m_transitionTable)
-            {
-                transitions.emplace_back(row.second.at(i));
-            }
-            statesTransitions[state] = transitions;
-            ++i;
-        }
+        WriteCsv(output, m_table);
+    }
 
-        return statesTransitions;
+    void Canonicalize() override
+    {
+        m_table = m_table.GetCanonical();
     }
 
-    std::map<State, State> GetNewStateNames(
-        std::map<std::vector<OutputSymbol>, std::vector<Group>>& outputToGroup) const
+    [[nodiscard]] std::string GetCanonicalHash() const override
     {
-        std::string inputState = m_states.front();
-        std::map<State, State> newStates;
-        for (int index = 1; auto& pair: outputToGroup)
-        {
-            for (auto& group: pair.second)
-            {
-                std::string oldStateName = group.GetMainState();
-                std::string newStateName;
-                if (oldStateName == inputState)
-                {
-                    newStateName = NEW_STATE_CHAR + std::to_string(0);
-                }
-                else
-                {
-                    newStateName = NEW_STATE_CHAR + std::to_string(index++);
-                }
+        std::ostringstream canonical;
+        WriteCsv(canonical, m_table.GetCanonical());
 
-                for (auto& state: group.GetStates())
-                {
-                    newStates[state] = newStateName;
-                }
-            }
-        }
+        Sha256 hash;
+        hash.Update(canonical.str());
 
-        return newStates;
+        return hash.HexDigest();
     }
 
-    static unsigned GetGroupsCount(std::map<std::vector<OutputSymbol>, std::vector<Group>>& group)
+    using IAutomata::Minimize;
+
+    PartitionAlgorithm::Stats Minimize(const PartitionAlgorithm::Algorithm algorithm) override
     {
-        unsigned size = 0;
-        for (auto& it: group)
-        {
-            size += it.second.size();
-        }
+        MMM_TRACE_SCOPE("Minimize");
+        const auto start = std::chrono::steady_clock::now();
+        RemoveImpossibleStates();
 
-        return size;
-    }
+        auto table = GetSparseTransitions();
+        auto initialBlocks = GetInitialBlocks();
 
-    std::map<State, std::vector<State>> GetStatesTransitions()
-    {
-        std::map<State, std::vector<State>> stateTransitions;
-        for (unsigned i = 0; auto& state: m_states)
-        {
-            std::vector<State> transitions;
-            for (auto& row: m_transitionTable)
-            {
-                transitions.emplace_back(row.second.at(i).nextState);
-            }
-            stateTransitions[state] = transitions;
-            ++i;
-        }
+        const auto refineStart = std::chrono::steady_clock::now();
+        PartitionAlgorithm::Stats stats;
+        auto blocks = PartitionAlgorithm::Refine(table, std::move(initialBlocks), algorithm, m_workerPool, stats);
+
+        const auto buildStart = std::chrono::steady_clock::now();
+        BuildMinimizedAutomata(blocks);
 
-        return stateTransitions;
+        stats.prepareMs = GetMilliseconds(start, refineStart);
+        stats.refineMs = GetMilliseconds(refineStart, buildStart);
+        stats.buildMs = GetMilliseconds(buildStart, std::chrono::steady_clock::now());
+        return stats;
     }
 
-    void InitGroups(std::map<State, Group*>& stateToGroup,
-        std::map<std::vector<OutputSymbol>, std::vector<Group>>& outputToGroup) const
+    void MinimizeWithDontCare(const OutputSymbol& wildcard, const DontCarePartition::Mode mode) override
     {
-        unsigned size = m_states.size();
-        for (size_t i = 0; i < size; i++)
-        {
-            std::string state = m_states.at(i);
+        MMM_TRACE_SCOPE("MinimizeWithDontCare");
+        RemoveImpossibleStates();
 
-            std::vector<OutputSymbol> transitions;
-            for (auto& it: m_transitionTable)
-            {
-                transitions.push_back(it.second.at(i).output);
-            }
+        auto table = GetSparseTransitions();
 
-            if (!outputToGroup.contains(transitions))
-            {
-                Group group;
-                group.AddState(m_states.at(i));
+        // a slot per defined transition, the table keeps them by state and class already
+        const DontCarePartition::SlotOutputs outputs = { m_table.transitions.rowOffsets, m_table.transitions.inputs,
+            m_table.transitionOutputs };
+        const uint32_t wildcardId = m_table.FindOutput(wildcard);
+        auto blocks = SparsePartition::Refine(table,
+            DontCarePartition::GetInitialBlocks(table, outputs, wildcardId, mode), m_workerPool);
 
-                outputToGroup[transitions].emplace_back(group);
-                stateToGroup[state] = &outputToGroup[transitions].back();
-            }
-            else
-            {
-                stateToGroup[state] = &outputToGroup[transitions].back();
-                outputToGroup[transitions].back().AddState(state);
-            }
-        }
+        BuildMinimizedAutomata(blocks, wildcardId);
     }
 
-    void RemoveImpossibleState()
+private:
+    // Every input symbol gets a line with the row of its class, undefined transitions are empty cells
+    static void WriteCsv(std::ostream& output, const AutomataTable& table)
     {
-        auto possibleStatesSet = GetAllPossibleStatesSet(m_transitionTable, m_states);
-        if (possibleStatesSet.size() == m_states.size())
+        std::string header;
+        for (const auto& state: table.states)
         {
-            return;
+            header += ';';
+            header += state;
         }
+        header += '\n';
+        output << header;
 
-        MealyStates newStates;
-        std::vector<int> indexesToRemove;
-
-        for (size_t i = 0; auto& it: m_states)
-        {
-            if (possibleStatesSet.contains(it))
-            {
-                newStates.emplace_back(it);
-            }
-            else
-            {
-                indexesToRemove.insert(indexesToRemove.begin(), i);
-            }
+        table.WriteRows(output, [&table](std::string& line, const TransitionCell& cell) {
+            line += table.states[cell.target];
+            line += '/';
+            line += table.outputSymbols[cell.output];
+        });
+    }
 
-            i++;
-        }
+    [[nodiscard]] SparseTransitionTable GetSparseTransitions() const
+    {
+        MMM_TRACE_SCOPE("GetSparseTransitions");
+        return m_table.GetRefinementTable(m_workerPool);
+    }
 
-        m_states = newStates;
+    // States with equal outputs on every input, undefined transitions output nothing
+    [[nodiscard]] std::vector<uint32_t> GetInitialBlocks() const
+    {
+        MMM_TRACE_SCOPE("GetInitialBlocks");
+        const auto& transitions = m_table.transitions;
+        std::map<std::vector<uint32_t>, uint32_t> outputToBlock;
+        std::vector<uint32_t> blocks;
 
-        for (auto& row: m_transitionTable)
+        // the key of a state lists (class, output) of its defined transitions
+        std::vector<uint32_t> outputs;
+        for (size_t state = 0; state < m_table.states.size(); ++state)
         {
-            for (auto i: indexesToRemove)
+            outputs.clear();
+            for (auto i = transitions.rowOffsets[state]; i < transitions.rowOffsets[state + 1]; ++i)
             {
-                row.second.erase(row.second.begin() + i);
+                outputs.push_back(transitions.inputs[i]);
+                outputs.push_back(m_table.transitionOutputs[i]);
             }
+
+            auto [it, _] = outputToBlock.emplace(outputs, static_cast<uint32_t>(outputToBlock.size()));
+            blocks.push_back(it->second);
         }
+
+        return blocks;
     }
 
-    static std::set<std::string> GetAllPossibleStatesSet(MealyTransitionTable& transitionTable, MealyStates& mealyStates)
+    // with a wildcard every merged transition outputs the specified output of any state of its block
+    void BuildMinimizedAutomata(const std::vector<uint32_t>& blocks,
+        const uint32_t wildcard = AutomataTable::NO_OUTPUT)
     {
-        std::vector<std::string> possibleStates = { mealyStates.front() };
-        std::set<std::string> possibleStatesSet = { mealyStates.front() };
-        size_t possibleStatesIndex = 0;
+        MMM_TRACE_SCOPE("BuildMinimizedAutomata");
+        auto [newIndexes, representatives] = SparsePartition::GetBlockRepresentatives(blocks);
+        auto minimized = m_table.GetQuotient(blocks, newIndexes, representatives);
 
-        while (possibleStatesIndex < possibleStates.size())
+        const auto& transitions = m_table.transitions;
+        for (uint32_t state = 0; wildcard != AutomataTable::NO_OUTPUT && state < m_table.states.size(); ++state)
         {
-            std::string sourceState = possibleStates[possibleStatesIndex];
-            size_t index = GetIndexOfStringInVector(mealyStates, possibleStates.at(possibleStatesIndex++));
-
-            for (auto& it: transitionTable)
+            const uint32_t newState = newIndexes[blocks[state]];
+            for (auto i = transitions.rowOffsets[state]; i < transitions.rowOffsets[state + 1]; ++i)
             {
-                std::string state = it.second[index].nextState;
-                if (!possibleStatesSet.contains(state))
+                const uint32_t newTransition = minimized.FindTransition(newState, transitions.inputs[i]);
+                if (newTransition != AutomataTable::NO_TRANSITION
+                    && minimized.transitionOutputs[newTransition] == wildcard)
                 {
-                    possibleStatesSet.insert(state);
-                    possibleStates.push_back(state);
+                    minimized.transitionOutputs[newTransition] = m_table.transitionOutputs[i];
                 }
             }
         }
 
-        return possibleStatesSet;
+        m_table = std::move(minimized);
+        m_table.MergeEqualClasses();
     }
 
-    static size_t GetIndexOfStringInVector(std::vector<std::string>& states, std::string& state)
+    void RemoveImpossibleStates()
     {
-        auto it = std::find(states.begin(), states.end(), state);
-
-        if (it != states.end())
-        {
-            return std::distance(states.begin(), it);
-        }
-
-        throw std::range_error("Invalid state");
+        MMM_TRACE_SCOPE("RemoveImpossibleStates");
+        m_table.RemoveUnreachableStates();
     }
 
-    MealyStates m_states;
-    MealyTransitionTable m_transitionTable;
+    AutomataTable m_table;
+    WorkerPool* m_workerPool = nullptr;
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,201 @@
+#pragma once
+#ifndef MEALY_COMPOSITION_H
+#define MEALY_COMPOSITION_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MealyAutomata.h"
+
+// Compositions of two Mealy automata. Only state pairs reachable from the pair of start states are built,
+// so the full |A| x |B| product is never allocated
+namespace MealyComposition
+{
+    constexpr char OUTPUT_PAIR_SEPARATOR = ',';
+    constexpr char OUTPUT_ESCAPE = '\\';
+    constexpr uint32_t NO_TRANSITION = AutomataTable::NO_TRANSITION;
+
+    inline const AutomataTable& GetTable(const MealyAutomata& automata)
+    {
+        if (automata.GetTable().states.empty())
+        {
+            throw std::invalid_argument("Cannot compose an automata without states");
+        }
+
+        return automata.GetTable();
+    }
+
+    // Output symbols of the table with the separator and the escape preceded by the escape,
+    // so that a product output splits back into its pair in one way only
+    inline std::vector<OutputSymbol> GetEscapedOutputs(const AutomataTable& table)
+    {
+        std::vector<OutputSymbol> escapedOutputs;
+        for (auto& output: table.outputSymbols)
+        {
+            auto& escaped = escapedOutputs.emplace_back();
+            for (const char ch: output)
+            {
+                if (ch == OUTPUT_PAIR_SEPARATOR || ch == OUTPUT_ESCAPE)
+                {
+                    escaped += OUTPUT_ESCAPE;
+                }
+                escaped += ch;
+            }
+        }
+
+        return escapedOutputs;
+    }
+
+    // Input symbol -> input class
+    inline std::unordered_map<InputSymbol, uint32_t> GetInputIndexes(const MealyAutomata& automata)
+    {
+        const auto& inputs = automata.GetTable().inputs;
+        return { inputs.begin(), inputs.end() };
+    }
+
+    // Breadth-first construction over state pairs, a row of defined transitions per pair.
+    // step(first, second, inputClass) returns the next pair and the output of the composed transition
+    // or nullopt if it is undefined
+    template <typename Step>
+    std::unique_ptr<MealyAutomata> BuildReachablePairs(const InputClasses& inputs, const size_t classesCount, Step&& step)
+    {
+        std::unordered_map<uint64_t, uint32_t> pairIndexes;
+        std::vector<std::pair<uint32_t, uint32_t>> pairs = { { 0, 0 } };
+        pairIndexes.emplace(0, 0);
+
+        AutomataTable table;
+        table.inputs = inputs;
+        table.classesCount = static_cast<uint32_t>(classesCount);
+        NameIndexes outputIds;
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            for (uint32_t input = 0; input < classesCount; ++input)
+            {
+                auto transition = step(pairs[i].first, pairs[i].second, input);
+                if (!transition)
+                {
+                    continue;
+                }
+
+                auto& [nextPair, output] = *transition;
+                const uint64_t key = static_cast<uint64_t>(nextPair.first) << 32 | nextPair.second;
+                auto [it, isNew] = pairIndexes.emplace(key, static_cast<uint32_t>(pairs.size()));
+                if (isNew)
+                {
+                    pairs.push_back(nextPair);
+                }
+                auto [outputId, isNewOutput] = outputIds.emplace(output, static_cast<uint32_t>(outputIds.size()));
+                if (isNewOutput)
+                {
+                    table.outputSymbols.push_back(std::move(output));
+                }
+
+                table.transitions.inputs.push_back(input);
+                table.transitions.targets.push_back(it->second);
+                table.transitionOutputs.push_back(outputId->second);
+            }
+            table.transitions.rowOffsets.push_back(static_cast<uint32_t>(table.transitions.targets.size()));
+        }
+
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            table.states.push_back(MealyAutomata::STATE_CHAR + std::to_string(i));
+        }
+
+        return std::make_unique<MealyAutomata>(std::move(table));
+    }
+
+    // Both automata read the same input, the output is "<first output>,<second output>" where commas and backslashes
+    // inside an output are escaped with a backslash.
+    // Input symbols of the first automata that the second one lacks have no transitions.
+    // A class of the product is a pair of classes of the first and the second automata
+    inline std::unique_ptr<MealyAutomata> GetParallelProduct(const MealyAutomata& first, const MealyAutomata& second)
+    {
+        const auto& firstTable = GetTable(first);
+        const auto& secondTable = GetTable(second);
+        const auto secondInputIndexes = GetInputIndexes(second);
+        const auto firstOutputs = GetEscapedOutputs(firstTable);
+        const auto secondOutputs = GetEscapedOutputs(secondTable);
+
+        InputClasses inputs;
+        std::unordered_map<uint64_t, uint32_t> classPairIndexes;
+        std::vector<uint32_t> firstInputs;
+        std::vector<uint32_t> secondInputs;
+        for (auto& [inputSymbol, firstClass]: firstTable.inputs)
+        {
+            auto it = secondInputIndexes.find(inputSymbol);
+            const uint32_t secondClass = it == secondInputIndexes.end() ? NO_TRANSITION : it->second;
+            const uint64_t key = static_cast<uint64_t>(firstClass) << 32 | secondClass;
+            auto [classPair, isNew] = classPairIndexes.emplace(key, static_cast<uint32_t>(firstInputs.size()));
+            if (isNew)
+            {
+                firstInputs.push_back(firstClass);
+                secondInputs.push_back(secondClass);
+            }
+            inputs.emplace_back(inputSymbol, classPair->second);
+        }
+
+        return BuildReachablePairs(inputs, firstInputs.size(), [&](const uint32_t firstState,
+            const uint32_t secondState, const uint32_t input)
+            -> std::optional<std::pair<std::pair<uint32_t, uint32_t>, OutputSymbol>> {
+            if (secondInputs[input] == NO_TRANSITION)
+            {
+                return std::nullopt;
+            }
+
+            const uint32_t firstPos = firstTable.FindTransition(firstState, firstInputs[input]);
+            const uint32_t secondPos = secondTable.FindTransition(secondState, secondInputs[input]);
+            if (firstPos == NO_TRANSITION || secondPos == NO_TRANSITION)
+            {
+                return std::nullopt;
+            }
+
+            return std::pair(
+                std::pair(firstTable.transitions.targets[firstPos], secondTable.transitions.targets[secondPos]),
+                firstOutputs[firstTable.transitionOutputs[firstPos]] + OUTPUT_PAIR_SEPARATOR
+                    + secondOutputs[secondTable.transitionOutputs[secondPos]]);
+        });
+    }
+
+    // Outputs of the first automata are inputs of the second one, the composed output is the second output.
+    // A transition is undefined if the second automata has no input equal to the first output
+    inline std::unique_ptr<MealyAutomata> GetSerialComposition(const MealyAutomata& first, const MealyAutomata& second)
+    {
+        const auto& firstTable = GetTable(first);
+        const auto& secondTable = GetTable(second);
+        const auto secondInputIndexes = GetInputIndexes(second);
+
+        return BuildReachablePairs(firstTable.inputs, firstTable.classesCount, [&](const uint32_t firstState,
+            const uint32_t secondState, const uint32_t input)
+            -> std::optional<std::pair<std::pair<uint32_t, uint32_t>, OutputSymbol>> {
+            const uint32_t firstPos = firstTable.FindTransition(firstState, input);
+            if (firstPos == NO_TRANSITION)
+            {
+                return std::nullopt;
+            }
+
+            auto secondInput = secondInputIndexes.find(firstTable.outputSymbols[firstTable.transitionOutputs[firstPos]]);
+            if (secondInput == secondInputIndexes.end())
+            {
+                return std::nullopt;
+            }
+
+            const uint32_t secondPos = secondTable.FindTransition(secondState, secondInput->second);
+            if (secondPos == NO_TRANSITION)
+            {
+                return std::nullopt;
+            }
+
+            return std::pair(
+                std::pair(firstTable.transitions.targets[firstPos], secondTable.transitions.targets[secondPos]),
+                secondTable.outputSymbols[secondTable.transitionOutputs[secondPos]]);
+        });
+    }
+}
+
+#endif
@@ -3,371 +3,197 @@
 #ifndef MOORE_AUTOMATA_H
 #define MOORE_AUTOMATA_H
 
+#include <chrono>
 #include <fstream>
-#include <list>
+#include <map>
+#include <sstream>
 #include <vector>
 
+#include "AutomataTable.h"
 #include "IAutomata.h"
-
-using MooreTransitionTable = std::list<std::pair<InputSymbol, std::vector<State>>>;
-using MooreStatesInfo = std::vector<std::pair<State, OutputSymbol>>;
+#include "PartitionAlgorithm.h"
+#include "SparseTransitionTable.h"
+#include "../Utils/CompressedIo.h"
+#include "../Utils/Sha256.h"
+#include "../Utils/Trace.h"
 
 class MooreAutomata final : public IAutomata
 {
 public:
-    MooreAutomata(
-        std::vector<InputSymbol>&& inputSymbols,
-        MooreStatesInfo&& statesInfo,
-        MooreTransitionTable&& transitionTable
-    )
-        : m_inputSymbols(std::move(inputSymbols)),
-        m_statesInfo(std::move(statesInfo)),
-        m_transitionTable(std::move(transitionTable))
+    // A table with an output id per state, as AutomataTableBuilder::Release(false) gives it
+    explicit MooreAutomata(AutomataTable table)
+        : m_table(std::move(table))
     {}
 
+    // Defined transitions by state over classes of input symbols, inputs gives the class of every symbol
+    [[nodiscard]] const AutomataTable& GetTable() const
+    {
+        return m_table;
+    }
+
+    [[nodiscard]] size_t GetStatesCount() const override
+    {
+        return m_table.states.size();
+    }
+
+    void SetWorkerPool(WorkerPool* pool) override
+    {
+        m_workerPool = pool;
+    }
+
     void ExportToCsv(const std::string &filename) const override
     {
-        std::ofstream file(filename);
+        std::ofstream file(filename, std::ios::binary);
         if (!file.is_open())
         {
             throw std::runtime_error("Could not open the file for writing.");
         }
 
-        std::string statesStr, outputSymbolsStr;
-        for (const auto& info : m_statesInfo)
-        {
-            outputSymbolsStr += ';' + info.second;
-            statesStr += ';' + info.first;
-        }
-        outputSymbolsStr += '\n';
-        statesStr += '\n';
-
-        file << outputSymbolsStr;
-        file << statesStr;
-
-        for (const auto& input : m_inputSymbols)
-        {
-            file << input;
-
-            for (const auto& transitions: m_transitionTable)
-            {
-                if (transitions.first == input)
-                {
-                    for (const auto& transition : transitions.second)
-                    {
-                        file << ";" << transition;
-                    }
-                    file << "\n";
-                }
-            }
-        }
+        WriteCompressed(file, GetCompressionByExtension(filename), [this](std::ostream& stream) {
+            WriteCsv(stream);
+        });
 
         file.close();
     }
 
-    void Minimize() override
+    void WriteCsv(std::ostream& output) const override
     {
-        RemoveImpossibleStates();
-
-        std::map<OutputSymbol, std::vector<Group>> groups;
-        std::map<State, Group*> stateToGroup;
-        InitGroups(groups, stateToGroup);
+        WriteCsv(output, m_table);
+    }
 
-        std::map<State, unsigned> stateIndexes = GetStateIndexes();
-        auto statesTransitions = GetStatesTransitions();
+    void Canonicalize() override
+    {
+        m_table = m_table.GetCanonical();
+    }
 
-        while (true)
-        {
-            bool isChangedSize = false;
-            for (auto& pair: groups)
-            {
-                std::vector<Group> newGroups;
-                for (auto& group : pair.second)
-                {
-                    if (group.GetStatesCount() <= 1)
-                    {
-                        continue;
-                    }
-
-                    std::string mainState = group.GetMainState();
-                    std::vector<Group*> groupTransitions;
-                    for (auto& state: statesTransitions[mainState])
-                    {
-                        groupTransitions.emplace_back(stateToGroup[state]);
-                    }
-
-                    for (auto& state: group.GetStates())
-                    {
-                        if (state == mainState)
-                        {
-                            continue;
-                        }
-
-                        for (unsigned i = 0; auto& it: statesTransitions[state])
-                        {
-                            if (groupTransitions.at(i++) != stateToGroup[it])
-                            {
-                                group.RemoveState(state);
-
-                                Group newGroup;
-                                newGroup.AddState(state);
-
-                                newGroups.push_back(newGroup);
-                                stateToGroup[state] = &newGroups.back();
-
-                                break;
-                            }
-                        }
-                    }
-                }
-
-                for (auto& it: newGroups)
-                {
-                    pair.second.push_back(it);
-                    if (!isChangedSize)
-                    {
-                        isChangedSize = true;
-                    }
-                }
-            }
+    [[nodiscard]] std::string GetCanonicalHash() const override
+    {
+        std::ostringstream canonical;
+        WriteCsv(canonical, m_table.GetCanonical());
 
-            if (!isChangedSize)
-            {
-                break;
-            }
-        }
+        Sha256 hash;
+        hash.Update(canonical.str());
 
-        BuildMinimizedAutomata(groups, stateIndexes);
+        return hash.HexDigest();
     }
 
-private:
-    static constexpr char NEW_STATE_CHAR = 'X';
+    using IAutomata::Minimize;
 
-    void BuildMinimizedAutomata(std::map<OutputSymbol, std::vector<Group>>& groups,
-        std::map<State, unsigned>& stateIndexes)
+    PartitionAlgorithm::Stats Minimize(const PartitionAlgorithm::Algorithm algorithm) override
     {
-        std::map<State, State> newStateNames = GetNewStateNames(groups);
+        MMM_TRACE_SCOPE("Minimize");
+        const auto start = std::chrono::steady_clock::now();
+        RemoveImpossibleStates();
 
-        std::vector<std::pair<InputSymbol, std::vector<State>>> transitionTableVector;
-        for (auto& row: m_transitionTable)
-        {
-            transitionTableVector.emplace_back(row.first, std::vector<State>());
-        }
+        auto table = GetSparseTransitions();
+        auto initialBlocks = GetInitialBlocks();
 
-        MooreStatesInfo newStatesInfo;
-        MooreTransitionTable newTransitionTable;
+        const auto refineStart = std::chrono::steady_clock::now();
+        PartitionAlgorithm::Stats stats;
+        auto blocks = PartitionAlgorithm::Refine(table, std::move(initialBlocks), algorithm, m_workerPool, stats);
 
-        for (auto& pair: groups)
-        {
-            for (auto& group: pair.second)
-            {
-                std::string oldState = group.GetMainState();
-                std::string newState = newStateNames[oldState];
-                unsigned stateIndex = stateIndexes[oldState];
-                std::string output = m_statesInfo[stateIndex].second;
-
-                if (stateIndex == 0)
-                {
-                    newStatesInfo.emplace(newStatesInfo.begin(), newState, output);
-                }
-                else
-                {
-                    newStatesInfo.emplace_back(newState, output);
-                }
-
-                for (unsigned i = 0; auto& row: m_transitionTable)
-                {
-                    std::string nextState = row.second[stateIndex];
-                    std::string newNextStateName = newStateNames[nextState];
-
-                    if (stateIndex == 0)
-                    {
-                        transitionTableVector.at(i).second.emplace(
-                            transitionTableVector.at(i).second.begin(), newNextStateName);
-                    }
-                    else
-                    {
-                        transitionTableVector.at(i).second.emplace_back(newNextStateName);
-                    }
-                    ++i;
-                }
-            }
-        }
+        const auto buildStart = std::chrono::steady_clock::now();
+        BuildMinimizedAutomata(blocks);
 
-        for (auto& row: transitionTableVector)
-        {
-            newTransitionTable.emplace_back(row);
-        }
-
-        m_statesInfo = newStatesInfo;
-        m_transitionTable = newTransitionTable;
+        stats.prepareMs = GetMilliseconds(start, refineStart);
+        stats.refineMs = GetMilliseconds(refineStart, buildStart);
+        stats.buildMs = GetMilliseconds(buildStart, std::chrono::steady_clock::now());
+        return stats;
     }
 
-    std::map<State, State> GetNewStateNames(std::map<OutputSymbol, std::vector<Group>>& groups) const
+    void MinimizeWithDontCare(const OutputSymbol& wildcard, const DontCarePartition::Mode mode) override
     {
-        std::string inputState = m_statesInfo.front().first;
+        MMM_TRACE_SCOPE("MinimizeWithDontCare");
+        RemoveImpossibleStates();
 
-        std::map<State, State> newStateNames;
-        unsigned stateIndex = 1;
+        auto table = GetSparseTransitions();
 
-        for (auto it: groups)
+        // a single slot per state
+        DontCarePartition::SlotOutputs outputs;
+        for (uint32_t state = 0; state < m_table.states.size(); ++state)
         {
-            for (auto& group: it.second)
-            {
-                std::string newStateName = group.GetMainState() == inputState
-                    ? NEW_STATE_CHAR + std::to_string(0)
-                    : NEW_STATE_CHAR + std::to_string(stateIndex++);
-                for (auto& state: group.GetStates())
-                {
-                    newStateNames[state] = newStateName;
-                }
-            }
+            outputs.offsets.push_back(state + 1);
+            outputs.slots.push_back(0);
         }
-        return newStateNames;
-    }
+        outputs.outputs = m_table.stateOutputs;
 
-    std::map<State, std::vector<State>> GetStatesTransitions()
-    {
-        std::map<State, std::vector<State>> statesTransitions;
-        for (unsigned i = 0; auto& stateInfo: m_statesInfo)
-        {
-            std::vector<State> transitions;
-            for (auto& row: m_transitionTable)
-            {
-                transitions.emplace_back(row.second.at(i));
-            }
-            statesTransitions[stateInfo.first] = transitions;
-            ++i;
-        }
+        const uint32_t wildcardId = m_table.FindOutput(wildcard);
+        auto blocks = SparsePartition::Refine(table,
+            DontCarePartition::GetInitialBlocks(table, outputs, wildcardId, mode), m_workerPool);
 
-        return statesTransitions;
+        BuildMinimizedAutomata(blocks, wildcardId);
     }
 
-    std::map<State, unsigned> GetStateIndexes()
+private:
+    static void WriteCsv(std::ostream& output, const AutomataTable& table)
     {
-        std::map<State, unsigned> stateIndexes;
-        for (unsigned index = 0; auto& state: m_statesInfo)
+        std::string statesStr, outputSymbolsStr;
+        for (size_t state = 0; state < table.states.size(); ++state)
         {
-            stateIndexes[state.first] = index++;
+            outputSymbolsStr += ';' + table.outputSymbols[table.stateOutputs[state]];
+            statesStr += ';' + table.states[state];
         }
+        outputSymbolsStr += '\n';
+        statesStr += '\n';
 
-        return stateIndexes;
-    }
+        output << outputSymbolsStr;
+        output << statesStr;
 
-    void InitGroups(std::map<OutputSymbol, std::vector<Group>>& groups,
-        std::map<State, Group*>& stateToGroup)
-    {
-        for (auto& it: GetOutputToStatesMap())
-        {
-            for (auto& state: it.second)
-            {
-                if (!groups.contains(it.first))
-                {
-                    groups.emplace(it.first, std::vector<Group>());
-                    groups[it.first].emplace_back();
-                }
-                groups.at(it.first).begin()->AddState(state);
-                stateToGroup[state] = &groups.at(it.first).front();
-            }
-        }
+        table.WriteRows(output, [&table](std::string& line, const TransitionCell& cell) {
+            line += table.states[cell.target];
+        });
     }
 
-    std::map<OutputSymbol, std::vector<State>> GetOutputToStatesMap()
+    [[nodiscard]] SparseTransitionTable GetSparseTransitions() const
     {
-        std::map<OutputSymbol, std::vector<State>> statesByOutput;
-
-        for(auto& stateInfo: m_statesInfo)
-        {
-            if (!statesByOutput.contains(stateInfo.second))
-            {
-                statesByOutput.emplace(stateInfo.second, std::vector<State>());
-            }
-            statesByOutput.find(stateInfo.second)->second.emplace_back(stateInfo.first);
-        }
-
-        return statesByOutput;
+        MMM_TRACE_SCOPE("GetSparseTransitions");
+        return m_table.GetRefinementTable(m_workerPool);
     }
 
-    void RemoveImpossibleStates()
+    [[nodiscard]] std::vector<uint32_t> GetInitialBlocks() const
     {
-        auto possibleStatesSet = GetPossibleStates();
-        if (possibleStatesSet.size() == m_statesInfo.size())
-        {
-            return;
-        }
-
-        MooreStatesInfo newStatesInfo;
-        std::vector<unsigned> indexesToRemove;
+        MMM_TRACE_SCOPE("GetInitialBlocks");
+        std::map<uint32_t, uint32_t> outputToBlock;
+        std::vector<uint32_t> blocks;
 
-        for (unsigned i = 0; auto& it: m_statesInfo)
+        for (auto output: m_table.stateOutputs)
         {
-            if (possibleStatesSet.contains(it.first))
-            {
-                newStatesInfo.emplace_back(it);
-            }
-            else
-            {
-                indexesToRemove.emplace(indexesToRemove.begin(), i);
-            }
-            ++i;
+            auto [it, _] = outputToBlock.emplace(output, static_cast<uint32_t>(outputToBlock.size()));
+            blocks.push_back(it->second);
         }
 
-        for (auto& row: m_transitionTable)
-        {
-            for (auto& it: indexesToRemove)
-            {
-                row.second.erase(row.second.begin() + it);
-            }
-        }
-
-        m_statesInfo = newStatesInfo;
+        return blocks;
     }
 
-    std::set<State> GetPossibleStates()
+    // with a wildcard every merged state outputs the specified output of any state of its block
+    void BuildMinimizedAutomata(const std::vector<uint32_t>& blocks,
+        const uint32_t wildcard = AutomataTable::NO_OUTPUT)
     {
-        std::vector<State> possibleStatesVector = { m_statesInfo.front().first };
-        std::set<State> possibleStates = { m_statesInfo.front().first };
-        size_t possibleStatesIndex = 0;
+        MMM_TRACE_SCOPE("BuildMinimizedAutomata");
+        auto [newIndexes, representatives] = SparsePartition::GetBlockRepresentatives(blocks);
+        auto minimized = m_table.GetQuotient(blocks, newIndexes, representatives);
 
-        while(possibleStatesIndex < possibleStatesVector.size())
+        for (size_t state = 0; wildcard != AutomataTable::NO_OUTPUT && state < m_table.states.size(); ++state)
         {
-            std::string sourceState = possibleStatesVector[possibleStatesIndex++];
-            size_t index = GetIndexOfState(m_statesInfo, sourceState);
-
-            for (auto& it: m_transitionTable)
+            auto& newOutput = minimized.stateOutputs[newIndexes[blocks[state]]];
+            if (newOutput == wildcard)
             {
-                std::string state = it.second[index];
-                if (!possibleStates.contains(state))
-                {
-                    possibleStates.insert(state);
-                    possibleStatesVector.push_back(state);
-                }
+                newOutput = m_table.stateOutputs[state];
             }
         }
 
-        return possibleStates;
+        m_table = std::move(minimized);
+        m_table.MergeEqualClasses();
     }
 
-    static size_t GetIndexOfState(MooreStatesInfo& statesInfo, std::string& state)
+    void RemoveImpossibleStates()
     {
-        unsigned index = 0;
-        for (auto& stateInfo: statesInfo)
-        {
-            if (stateInfo.first == state)
-            {
-                return index;
-            }
-
-            ++index;
-        }
-
-        throw std::range_error("Invalid state");
+        MMM_TRACE_SCOPE("RemoveImpossibleStates");
+        m_table.RemoveUnreachableStates();
     }
 
-
-    std::vector<std::string> m_inputSymbols;
-    MooreStatesInfo m_statesInfo;
-    MooreTransitionTable m_transitionTable;
+    AutomataTable m_table;
+    WorkerPool* m_workerPool = nullptr;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,708 @@
+#pragma once
+#ifndef PARTITION_ALGORITHM_H
+#define PARTITION_ALGORITHM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "SparseTransitionTable.h"
+#include "../Utils/Trace.h"
+
+// Engines computing the coarsest refinement of an initial partition, all give the same partition.
+// A missing transition is equal only to a missing one in every engine
+namespace PartitionAlgorithm
+{
+    enum class Algorithm
+    {
+        Auto,
+        // SparsePartition::Refine, splits the blocks on a worklist
+        Iterative,
+        // Hopcroft's "process the smaller half" splitters, O(inputs * states * log states)
+        Hopcroft,
+        // rounds of signature hashing by state ranges on the worker pool
+        Parallel,
+        // subsets of the reversed automata from the initial blocks, no refinement rounds at all
+        Brzozowski
+    };
+
+    // Brzozowski gives up when the reversed subsets hold more than this many states per state of the
+    // automata, or more than the total limit
+    constexpr size_t BRZOZOWSKI_ELEMENTS_PER_STATE = 64;
+    constexpr size_t BRZOZOWSKI_ELEMENTS_LIMIT = 1 << 24;
+    // Hopcroft keeps a flag per (block, input) pair
+    constexpr size_t HOPCROFT_PAIRS_LIMIT = size_t(1) << 28;
+    // Hopcroft fills every missing transition with the sink and queues a split block on every input, so it
+    // pays for states * inputs whatever is defined. Below this density the worklist is guessed instead
+    constexpr double HOPCROFT_MIN_DENSITY = 0.25;
+
+    inline Algorithm ParseAlgorithm(const std::string& algorithm)
+    {
+        if (algorithm == "auto")
+        {
+            return Algorithm::Auto;
+        }
+        if (algorithm == "iterative")
+        {
+            return Algorithm::Iterative;
+        }
+        if (algorithm == "hopcroft")
+        {
+            return Algorithm::Hopcroft;
+        }
+        if (algorithm == "parallel")
+        {
+            return Algorithm::Parallel;
+        }
+        if (algorithm == "brzozowski")
+        {
+            return Algorithm::Brzozowski;
+        }
+
+        throw std::invalid_argument("Invalid algorithm " + algorithm);
+    }
+
+    inline std::string GetAlgorithmName(const Algorithm algorithm)
+    {
+        switch (algorithm)
+        {
+            case Algorithm::Auto:
+                return "auto";
+            case Algorithm::Iterative:
+                return "iterative";
+            case Algorithm::Hopcroft:
+                return "hopcroft";
+            case Algorithm::Parallel:
+                return "parallel";
+            case Algorithm::Brzozowski:
+                return "brzozowski";
+        }
+
+        return "unknown";
+    }
+
+    // Cheap statistics of the table the choice is made from, and what the minimization did
+    struct Stats
+    {
+        size_t statesCount = 0;
+        size_t inputsCount = 0;
+        size_t transitionsCount = 0;
+        size_t initialBlocksCount = 0;
+        // defined transitions / (states * inputs)
+        double density = 0;
+        size_t workersCount = 1;
+
+        Algorithm algorithm = Algorithm::Auto;
+        // engine that finished the work when the chosen one gave up
+        std::optional<Algorithm> fallback;
+        size_t blocksCount = 0;
+        double prepareMs = 0;
+        double refineMs = 0;
+        double buildMs = 0;
+    };
+
+    inline size_t GetInputsCount(const SparseTransitionTable& table)
+    {
+        size_t inputsCount = 0;
+        for (auto input: table.inputs)
+        {
+            inputsCount = std::max<size_t>(inputsCount, input + 1);
+        }
+
+        return inputsCount;
+    }
+
+    inline Stats GetStats(const SparseTransitionTable& table, const std::vector<uint32_t>& blocks, WorkerPool* pool)
+    {
+        Stats stats;
+        stats.statesCount = table.GetStatesCount();
+        stats.inputsCount = GetInputsCount(table);
+        stats.transitionsCount = table.targets.size();
+        stats.initialBlocksCount = SparsePartition::GetBlocksCount(blocks);
+        stats.density = stats.statesCount * stats.inputsCount == 0
+            ? 1.0
+            : static_cast<double>(stats.transitionsCount) / static_cast<double>(stats.statesCount * stats.inputsCount);
+        stats.workersCount = pool ? pool->GetWorkersCount() : 1;
+
+        return stats;
+    }
+
+    inline bool IsHopcroftAffordable(const Stats& stats)
+    {
+        return (stats.statesCount + 1) * std::max<size_t>(stats.inputsCount, 1) <= HOPCROFT_PAIRS_LIMIT;
+    }
+
+    // Small tables do not pay for any setup. Long chains cost the worklist and the parallel rounds time
+    // quadratic in the chain length, and Hopcroft's bound holds for any shape, so it is the choice whenever
+    // its pairs fit and most transitions are defined. On a sparse table Hopcroft's states * inputs work
+    // dwarfs the worklist's, which only follows the defined transitions. The parallel rounds are guessed
+    // only for large tables Hopcroft does not take, where the worklist would be just as quadratic on one
+    // thread. Brzozowski is never guessed: on chains, cycles and random tables Hopcroft was faster,
+    // and a wrong guess costs the subset budget
+    inline Algorithm ChooseAlgorithm(const Stats& stats)
+    {
+        if (stats.statesCount < (1 << 10))
+        {
+            return Algorithm::Iterative;
+        }
+        if (IsHopcroftAffordable(stats) && stats.density >= HOPCROFT_MIN_DENSITY)
+        {
+            return Algorithm::Hopcroft;
+        }
+        if (stats.workersCount > 1 && stats.statesCount >= (1 << 17))
+        {
+            return Algorithm::Parallel;
+        }
+
+        return Algorithm::Iterative;
+    }
+
+    // Transitions of the table completed with a sink state: a missing transition goes to the sink
+    // and the sink loops on every input. The sink is state statesCount and alone in its block
+    class CompletedTable
+    {
+    public:
+        CompletedTable(const SparseTransitionTable& table, const size_t inputsCount, WorkerPool* pool)
+            : m_statesCount(table.GetStatesCount()),
+            m_inputsCount(inputsCount),
+            m_predecessors(table.GetReversed(pool)),
+            m_sinkPredecessors(inputsCount)
+        {
+            for (uint32_t state = 0; state < m_statesCount; ++state)
+            {
+                auto i = table.rowOffsets[state];
+                for (uint32_t input = 0; input < m_inputsCount; ++input)
+                {
+                    if (i < table.rowOffsets[state + 1] && table.inputs[i] == input)
+                    {
+                        ++i;
+                    }
+                    else
+                    {
+                        m_sinkPredecessors[input].push_back(state);
+                    }
+                }
+            }
+            for (auto& predecessors: m_sinkPredecessors)
+            {
+                predecessors.push_back(static_cast<uint32_t>(m_statesCount));
+            }
+        }
+
+        [[nodiscard]] uint32_t GetSink() const
+        {
+            return static_cast<uint32_t>(m_statesCount);
+        }
+
+        // Calls visit(source) for every transition on input into target
+        template <typename Visit>
+        void ForEachPredecessor(const uint32_t target, const uint32_t input, Visit&& visit) const
+        {
+            if (target == GetSink())
+            {
+                for (auto source: m_sinkPredecessors[input])
+                {
+                    visit(source);
+                }
+                return;
+            }
+
+            const auto begin = m_predecessors.inputs.begin() + m_predecessors.rowOffsets[target];
+            const auto end = m_predecessors.inputs.begin() + m_predecessors.rowOffsets[target + 1];
+            for (auto it = std::lower_bound(begin, end, input); it != end && *it == input; ++it)
+            {
+                visit(m_predecessors.targets[it - m_predecessors.inputs.begin()]);
+            }
+        }
+
+    private:
+        size_t m_statesCount;
+        size_t m_inputsCount;
+        SparseTransitionTable m_predecessors;
+        std::vector<std::vector<uint32_t>> m_sinkPredecessors;
+    };
+
+    // Refinable partition of Valmari and Lehtinen: the states of a block are contiguous in m_elements,
+    // the marked ones at its front
+    class RefinablePartition
+    {
+    public:
+        explicit RefinablePartition(const std::vector<uint32_t>& blocks)
+            : m_elements(blocks.size()),
+            m_locations(blocks.size()),
+            m_blocks(blocks)
+        {
+            const uint32_t blocksCount = SparsePartition::GetBlocksCount(blocks);
+            m_first.assign(blocksCount + 1, 0);
+            for (auto block: blocks)
+            {
+                ++m_first[block + 1];
+            }
+            for (uint32_t block = 0; block < blocksCount; ++block)
+            {
+                m_first[block + 1] += m_first[block];
+            }
+
+            std::vector<uint32_t> positions(m_first.begin(), m_first.end() - 1);
+            for (uint32_t element = 0; element < blocks.size(); ++element)
+            {
+                m_locations[element] = positions[blocks[element]]++;
+                m_elements[m_locations[element]] = element;
+            }
+            m_end.assign(m_first.begin() + 1, m_first.end());
+            m_first.pop_back();
+            m_marked = m_first;
+        }
+
+        [[nodiscard]] uint32_t GetBlocksCount() const
+        {
+            return static_cast<uint32_t>(m_first.size());
+        }
+
+        [[nodiscard]] uint32_t GetBlock(const uint32_t element) const
+        {
+            return m_blocks[element];
+        }
+
+        [[nodiscard]] std::vector<uint32_t> GetElements(const uint32_t block) const
+        {
+            return { m_elements.begin() + m_first[block], m_elements.begin() + m_end[block] };
+        }
+
+        [[nodiscard]] uint32_t GetSize(const uint32_t block) const
+        {
+            return m_end[block] - m_first[block];
+        }
+
+        void Mark(const uint32_t element)
+        {
+            const uint32_t block = m_blocks[element];
+            const uint32_t location = m_locations[element];
+            const uint32_t markedEnd = m_marked[block];
+            if (location < markedEnd)
+            {
+                return;
+            }
+            if (markedEnd == m_first[block])
+            {
+                m_touched.push_back(block);
+            }
+
+            std::swap(m_elements[location], m_elements[markedEnd]);
+            m_locations[m_elements[location]] = location;
+            m_locations[m_elements[markedEnd]] = markedEnd;
+            ++m_marked[block];
+        }
+
+        // Moves the marked part of every partly marked block into a new block, calls split(block, newBlock)
+        template <typename Split>
+        void SplitTouched(Split&& split)
+        {
+            for (auto block: m_touched)
+            {
+                const uint32_t markedEnd = m_marked[block];
+                m_marked[block] = m_first[block];
+                if (markedEnd == m_end[block])
+                {
+                    continue;
+                }
+
+                const uint32_t newBlock = GetBlocksCount();
+                m_first.push_back(m_first[block]);
+                m_end.push_back(markedEnd);
+                m_marked.push_back(m_first[block]);
+                m_first[block] = markedEnd;
+                m_marked[block] = markedEnd;
+                for (auto i = m_first[newBlock]; i < m_end[newBlock]; ++i)
+                {
+                    m_blocks[m_elements[i]] = newBlock;
+                }
+
+                split(block, newBlock);
+            }
+            m_touched.clear();
+        }
+
+        [[nodiscard]] const std::vector<uint32_t>& GetBlocks() const
+        {
+            return m_blocks;
+        }
+
+    private:
+        std::vector<uint32_t> m_elements;
+        std::vector<uint32_t> m_locations;
+        std::vector<uint32_t> m_blocks;
+        std::vector<uint32_t> m_first;
+        std::vector<uint32_t> m_end;
+        std::vector<uint32_t> m_marked;
+        std::vector<uint32_t> m_touched;
+    };
+
+    // Every initial block is a splitter on every input, which keeps the algorithm correct for any initial partition
+    inline std::vector<uint32_t> RefineHopcroft(const SparseTransitionTable& table, const std::vector<uint32_t>& blocks,
+        const size_t inputsCount, WorkerPool* pool)
+    {
+        const size_t statesCount = table.GetStatesCount();
+        if (statesCount == 0 || inputsCount == 0)
+        {
+            return blocks;
+        }
+
+        MMM_TRACE_SCOPE("RefineHopcroft");
+        const CompletedTable completed(table, inputsCount, pool);
+        std::vector<uint32_t> completedBlocks = blocks;
+        completedBlocks.push_back(SparsePartition::GetBlocksCount(blocks));
+        RefinablePartition partition(completedBlocks);
+
+        std::vector<std::pair<uint32_t, uint32_t>> worklist;
+        std::vector<bool> isQueued;
+        auto enqueue = [&](const uint32_t block, const uint32_t input) {
+            const size_t pos = size_t(block) * inputsCount + input;
+            if (isQueued.size() <= pos)
+            {
+                isQueued.resize(std::max(pos + 1, isQueued.size() * 2), false);
+            }
+            isQueued[pos] = true;
+            worklist.emplace_back(block, input);
+        };
+        auto isInWorklist = [&](const uint32_t block, const uint32_t input) {
+            const size_t pos = size_t(block) * inputsCount + input;
+            return pos < isQueued.size() && isQueued[pos];
+        };
+
+        for (uint32_t block = 0; block < partition.GetBlocksCount(); ++block)
+        {
+            for (uint32_t input = 0; input < inputsCount; ++input)
+            {
+                enqueue(block, input);
+            }
+        }
+
+        [[maybe_unused]] size_t splitsCount = 0;
+        for (size_t examinedCount = 0; !worklist.empty(); ++examinedCount)
+        {
+            if (examinedCount % SparsePartition::TRACE_SAMPLE_INTERVAL == 0)
+            {
+                MMM_TRACE_COUNTER("blocks", partition.GetBlocksCount() - 1);
+                MMM_TRACE_COUNTER("worklist", worklist.size());
+            }
+
+            const auto [splitter, input] = worklist.back();
+            worklist.pop_back();
+            isQueued[size_t(splitter) * inputsCount + input] = false;
+
+            for (auto target: partition.GetElements(splitter))
+            {
+                completed.ForEachPredecessor(target, input, [&partition](const uint32_t source) {
+                    partition.Mark(source);
+                });
+            }
+
+            partition.SplitTouched([&](const uint32_t block, const uint32_t newBlock) {
+                ++splitsCount;
+                for (uint32_t splitInput = 0; splitInput < inputsCount; ++splitInput)
+                {
+                    if (isInWorklist(block, splitInput))
+                    {
+                        enqueue(newBlock, splitInput);
+                    }
+                    else
+                    {
+                        enqueue(partition.GetSize(newBlock) < partition.GetSize(block) ? newBlock : block, splitInput);
+                    }
+                }
+            });
+        }
+
+        // the sink's block is not counted
+        MMM_TRACE_COUNTER("blocks", partition.GetBlocksCount() - 1);
+        MMM_TRACE_INSTANT("Refined", Trace::Args()
+            .Add("split", splitsCount).Add("blocks", partition.GetBlocksCount() - 1).Get());
+        std::vector<uint32_t> result(partition.GetBlocks().begin(), partition.GetBlocks().end() - 1);
+        return result;
+    }
+
+    // Rounds of the naive algorithm: a state keeps its block only with the states whose block and
+    // (input, target block) pairs equal its own. Hashes are computed by state ranges on the pool,
+    // a round that creates no block ends the refinement
+    inline std::vector<uint32_t> RefineParallel(const SparseTransitionTable& table, std::vector<uint32_t> blocks,
+        WorkerPool* pool)
+    {
+        MMM_TRACE_SCOPE("RefineParallel");
+        const size_t statesCount = table.GetStatesCount();
+        StateArray hashesLow(statesCount);
+        StateArray hashesHigh(statesCount);
+        uint32_t blocksCount = SparsePartition::GetBlocksCount(blocks);
+
+        auto isSameSignature = [&table, &blocks](const uint32_t first, const uint32_t second) {
+            if (blocks[first] != blocks[second])
+            {
+                return false;
+            }
+
+            const auto firstBegin = table.rowOffsets[first];
+            const auto secondBegin = table.rowOffsets[second];
+            const size_t size = table.rowOffsets[first + 1] - firstBegin;
+            if (size != table.rowOffsets[second + 1] - secondBegin
+                || !SimdRows::AreEqual(table.inputs.data() + firstBegin, table.inputs.data() + secondBegin, size))
+            {
+                return false;
+            }
+
+            return SimdRows::AreGatheredEqual(blocks.data(),
+                table.targets.data() + firstBegin, table.targets.data() + secondBegin, size);
+        };
+
+        std::unordered_map<uint64_t, uint32_t> hashToBlock;
+        std::vector<uint32_t> representatives;
+        std::vector<uint32_t> nextWithSameHash;
+        std::vector<uint32_t> newBlocks(statesCount);
+        for (size_t round = 1; ; ++round)
+        {
+            MMM_TRACE_SCOPE("Round");
+            RunByRanges(pool, statesCount, [&](size_t, const size_t begin, const size_t end) {
+                MMM_TRACE_SCOPE("HashStates");
+                for (size_t state = begin; state < end; ++state)
+                {
+                    const auto rowBegin = table.rowOffsets[state];
+                    const uint64_t hash = SimdRows::HashPairs(table.inputs.data() + rowBegin, blocks.data(),
+                        table.targets.data() + rowBegin, table.rowOffsets[state + 1] - rowBegin, blocks[state]);
+                    hashesLow[state] = static_cast<uint32_t>(hash);
+                    hashesHigh[state] = static_cast<uint32_t>(hash >> 32);
+                }
+            });
+
+            hashToBlock.clear();
+            hashToBlock.reserve(blocksCount * 2);
+            representatives.clear();
+            nextWithSameHash.clear();
+            for (uint32_t state = 0; state < statesCount; ++state)
+            {
+                const uint64_t hash = uint64_t(hashesHigh[state]) << 32 | hashesLow[state];
+                auto [it, isNew] = hashToBlock.emplace(hash, static_cast<uint32_t>(representatives.size()));
+
+                uint32_t block = isNew ? SparsePartition::NO_BLOCK : it->second;
+                while (block != SparsePartition::NO_BLOCK && !isSameSignature(state, representatives[block]))
+                {
+                    block = nextWithSameHash[block];
+                }
+                if (block == SparsePartition::NO_BLOCK)
+                {
+                    block = static_cast<uint32_t>(representatives.size());
+                    representatives.push_back(state);
+                    nextWithSameHash.push_back(isNew ? SparsePartition::NO_BLOCK : it->second);
+                    it->second = block;
+                }
+                newBlocks[state] = block;
+            }
+
+            MMM_TRACE_INSTANT("RoundBlocks", Trace::Args()
+                .Add("round", round)
+                .Add("blocks", representatives.size())
+                .Add("created", representatives.size() - blocksCount)
+                .AddRaw("sizes", Trace::GetBlockSizeHistogram(newBlocks)).Get());
+            MMM_TRACE_COUNTER("blocks", representatives.size());
+            if (representatives.size() == blocksCount)
+            {
+                return blocks;
+            }
+            blocksCount = static_cast<uint32_t>(representatives.size());
+            blocks.swap(newBlocks);
+        }
+    }
+
+    // Reverse subset construction: q is in the subset reached from initial block B by the reversed word w
+    // exactly when the word w leads q into B. So two states are equivalent when they belong to the same subsets.
+    // Works for Mealy tables too, their initial blocks already hold the outputs of every input.
+    // Returns false when the subsets outgrow the limits, random tables reach exponentially many of them
+    inline bool RefineBrzozowski(const SparseTransitionTable& table, std::vector<uint32_t>& blocks,
+        const size_t inputsCount, WorkerPool* pool)
+    {
+        const size_t statesCount = table.GetStatesCount();
+        if (statesCount == 0)
+        {
+            return true;
+        }
+
+        MMM_TRACE_SCOPE("RefineBrzozowski");
+        const CompletedTable completed(table, inputsCount, pool);
+        const uint32_t initialBlocksCount = SparsePartition::GetBlocksCount(blocks);
+        const size_t elementsLimit = std::min(BRZOZOWSKI_ELEMENTS_LIMIT, BRZOZOWSKI_ELEMENTS_PER_STATE * (statesCount + 1));
+
+        std::vector<uint32_t> elements;
+        std::vector<size_t> offsets = { 0 };
+        std::unordered_multimap<size_t, uint32_t> subsetsByHash;
+        size_t elementsCount = 0;
+
+        auto addSubset = [&](std::vector<uint32_t>& subset) {
+            std::ranges::sort(subset);
+            const SparsePartition::SignatureView view { subset.data(), subset.size() };
+            const size_t hash = SparsePartition::SignatureViewHash{}(view);
+            auto [begin, end] = subsetsByHash.equal_range(hash);
+            for (auto it = begin; it != end; ++it)
+            {
+                const SparsePartition::SignatureView other { elements.data() + offsets[it->second],
+                    offsets[it->second + 1] - offsets[it->second] };
+                if (other == view)
+                {
+                    return;
+                }
+            }
+
+            subsetsByHash.emplace(hash, static_cast<uint32_t>(offsets.size() - 1));
+            elements.insert(elements.end(), subset.begin(), subset.end());
+            offsets.push_back(elements.size());
+            elementsCount += subset.size();
+        };
+
+        std::vector<std::vector<uint32_t>> initialSubsets(initialBlocksCount + 1);
+        for (uint32_t state = 0; state < statesCount; ++state)
+        {
+            initialSubsets[blocks[state]].push_back(state);
+        }
+        initialSubsets.back().push_back(completed.GetSink());
+        for (auto& subset: initialSubsets)
+        {
+            if (!subset.empty())
+            {
+                addSubset(subset);
+            }
+        }
+
+        std::vector<uint32_t> predecessors;
+        std::vector<uint32_t> markGeneration(statesCount + 1, 0);
+        uint32_t generation = 0;
+        for (size_t subset = 0; subset + 1 < offsets.size(); ++subset)
+        {
+            if (subset % SparsePartition::TRACE_SAMPLE_INTERVAL == 0)
+            {
+                MMM_TRACE_COUNTER("subsets", offsets.size() - 1);
+                MMM_TRACE_COUNTER("subset elements", elementsCount);
+            }
+
+            for (uint32_t input = 0; input < inputsCount; ++input)
+            {
+                ++generation;
+                predecessors.clear();
+                for (auto i = offsets[subset]; i < offsets[subset + 1]; ++i)
+                {
+                    completed.ForEachPredecessor(elements[i], input, [&](const uint32_t source) {
+                        if (markGeneration[source] != generation)
+                        {
+                            markGeneration[source] = generation;
+                            predecessors.push_back(source);
+                        }
+                    });
+                }
+
+                if (!predecessors.empty())
+                {
+                    addSubset(predecessors);
+                }
+                if (elementsCount > elementsLimit)
+                {
+                    MMM_TRACE_INSTANT("OverBudget", Trace::Args()
+                        .Add("subsets", offsets.size() - 1).Add("elements", elementsCount).Get());
+                    return false;
+                }
+            }
+        }
+
+        // subsets of every state, in subset order
+        std::vector<uint32_t> memberships(statesCount + 1, 0);
+        for (auto state: elements)
+        {
+            ++memberships[state];
+        }
+        std::vector<size_t> membershipOffsets(statesCount + 2, 0);
+        for (size_t state = 0; state <= statesCount; ++state)
+        {
+            membershipOffsets[state + 1] = membershipOffsets[state] + memberships[state];
+        }
+        std::vector<uint32_t> stateSubsets(elements.size());
+        std::vector<size_t> positions(membershipOffsets.begin(), membershipOffsets.end() - 1);
+        for (size_t subset = 0; subset + 1 < offsets.size(); ++subset)
+        {
+            for (auto i = offsets[subset]; i < offsets[subset + 1]; ++i)
+            {
+                stateSubsets[positions[elements[i]]++] = static_cast<uint32_t>(subset);
+            }
+        }
+
+        std::unordered_map<SparsePartition::SignatureView, uint32_t, SparsePartition::SignatureViewHash> subsetsToBlock;
+        for (uint32_t state = 0; state < statesCount; ++state)
+        {
+            const SparsePartition::SignatureView view { stateSubsets.data() + membershipOffsets[state],
+                membershipOffsets[state + 1] - membershipOffsets[state] };
+            blocks[state] = subsetsToBlock.emplace(view, static_cast<uint32_t>(subsetsToBlock.size())).first->second;
+        }
+
+        return true;
+    }
+
+    // Runs the requested engine, Auto chooses from the statistics. Records the choice in stats.
+    // An engine over its memory budget leaves the work to Hopcroft, or to Iterative if Hopcroft is over it too
+    inline std::vector<uint32_t> Refine(const SparseTransitionTable& table, std::vector<uint32_t> blocks,
+        const Algorithm algorithm, WorkerPool* pool, Stats& stats)
+    {
+        MMM_TRACE_SCOPE("Refine");
+        stats = GetStats(table, blocks, pool);
+        stats.algorithm = algorithm == Algorithm::Auto ? ChooseAlgorithm(stats) : algorithm;
+        MMM_TRACE_INSTANT("InitialPartition", Trace::Args()
+            .Add("states", stats.statesCount)
+            .Add("inputs", stats.inputsCount)
+            .Add("transitions", stats.transitionsCount)
+            .Add("blocks", stats.initialBlocksCount)
+            .AddRaw("algorithm", "\"" + GetAlgorithmName(stats.algorithm) + "\"")
+            .AddRaw("sizes", Trace::GetBlockSizeHistogram(blocks)).Get());
+        const Algorithm fallback = IsHopcroftAffordable(stats) ? Algorithm::Hopcroft : Algorithm::Iterative;
+
+        switch (stats.algorithm)
+        {
+            case Algorithm::Hopcroft:
+                if (IsHopcroftAffordable(stats))
+                {
+                    blocks = RefineHopcroft(table, blocks, stats.inputsCount, pool);
+                }
+                else
+                {
+                    stats.fallback = Algorithm::Iterative;
+                }
+                break;
+            case Algorithm::Parallel:
+                blocks = RefineParallel(table, std::move(blocks), pool);
+                break;
+            case Algorithm::Brzozowski:
+                if (!RefineBrzozowski(table, blocks, stats.inputsCount, pool))
+                {
+                    stats.fallback = fallback;
+                }
+                break;
+            default:
+                blocks = SparsePartition::Refine(table, std::move(blocks), pool);
+                break;
+        }
+
+        if (stats.fallback == Algorithm::Hopcroft)
+        {
+            blocks = RefineHopcroft(table, blocks, stats.inputsCount, pool);
+        }
+        else if (stats.fallback == Algorithm::Iterative)
+        {
+            blocks = SparsePartition::Refine(table, std::move(blocks), pool);
+        }
+
+        stats.blocksCount = SparsePartition::GetBlockRepresentatives(blocks).second.size();
+        MMM_TRACE_INSTANT("Partition", Trace::Args()
+            .Add("blocks", stats.blocksCount)
+            .AddRaw("sizes", Trace::GetBlockSizeHistogram(blocks)).Get());
+        return blocks;
+    }
+}
+
+#endif
@@ -0,0 +1,320 @@
+#pragma once
+#ifndef SPARSE_TRANSITION_TABLE_H
+#define SPARSE_TRANSITION_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../Utils/SimdRows.h"
+#include "../Utils/Trace.h"
+#include "../Utils/WorkerPool.h"
+
+// Compressed sparse row storage of the defined transitions:
+// transitions of state s are [rowOffsets[s], rowOffsets[s + 1]) ordered by input
+struct SparseTransitionTable
+{
+    StateArray rowOffsets = { 0 };
+    StateArray inputs;
+    StateArray targets;
+
+    [[nodiscard]] size_t GetStatesCount() const
+    {
+        return rowOffsets.size() - 1;
+    }
+
+    // Predecessors: row s holds the transitions into s ordered by input, targets are their source states.
+    // Rows are sorted by state ranges on the pool
+    [[nodiscard]] SparseTransitionTable GetReversed(WorkerPool* pool = nullptr) const
+    {
+        MMM_TRACE_SCOPE("GetReversed");
+        const size_t statesCount = GetStatesCount();
+
+        SparseTransitionTable reversed;
+        reversed.rowOffsets.assign(statesCount + 1, 0);
+        reversed.inputs.resize(targets.size());
+        reversed.targets.resize(targets.size());
+
+        for (auto target: targets)
+        {
+            ++reversed.rowOffsets[target + 1];
+        }
+        for (size_t state = 0; state < statesCount; ++state)
+        {
+            reversed.rowOffsets[state + 1] += reversed.rowOffsets[state];
+        }
+
+        std::vector<uint32_t> positions(reversed.rowOffsets.begin(), reversed.rowOffsets.end() - 1);
+        for (uint32_t state = 0; state < statesCount; ++state)
+        {
+            for (auto i = rowOffsets[state]; i < rowOffsets[state + 1]; ++i)
+            {
+                const uint32_t pos = positions[targets[i]]++;
+                reversed.inputs[pos] = inputs[i];
+                reversed.targets[pos] = state;
+            }
+        }
+
+        RunByRanges(pool, statesCount, [&reversed](size_t, const size_t begin, const size_t end) {
+            std::vector<std::pair<uint32_t, uint32_t>> predecessors;
+            for (size_t state = begin; state < end; ++state)
+            {
+                predecessors.clear();
+                for (auto i = reversed.rowOffsets[state]; i < reversed.rowOffsets[state + 1]; ++i)
+                {
+                    predecessors.emplace_back(reversed.inputs[i], reversed.targets[i]);
+                }
+                std::ranges::sort(predecessors);
+                for (auto i = reversed.rowOffsets[state]; auto& [input, source]: predecessors)
+                {
+                    reversed.inputs[i] = input;
+                    reversed.targets[i++] = source;
+                }
+            }
+        });
+
+        return reversed;
+    }
+
+    // Builds the table by state ranges: forEachTransition(state, add) calls add(input, target) for the
+    // transitions of the state in input order. Each worker collects its states locally, then copies them
+    // into its own slice of the arrays, so the slice is first touched on the worker's memory node
+    template <typename ForEachTransition>
+    static SparseTransitionTable Build(const size_t statesCount, WorkerPool* pool, ForEachTransition&& forEachTransition)
+    {
+        const size_t workersCount = pool ? pool->GetWorkersCount() : 1;
+
+        SparseTransitionTable table;
+        table.rowOffsets.resize(statesCount + 1);
+        table.rowOffsets[0] = 0;
+
+        std::vector<StateArray> workerInputs(workersCount);
+        std::vector<StateArray> workerTargets(workersCount);
+        RunByRanges(pool, statesCount, [&](const size_t worker, const size_t begin, const size_t end) {
+            auto& inputs = workerInputs[worker];
+            auto& targets = workerTargets[worker];
+            for (size_t state = begin; state < end; ++state)
+            {
+                forEachTransition(state, [&inputs, &targets](const uint32_t input, const uint32_t target) {
+                    inputs.push_back(input);
+                    targets.push_back(target);
+                });
+                table.rowOffsets[state + 1] = static_cast<uint32_t>(targets.size());
+            }
+        });
+
+        std::vector<uint32_t> workerOffsets(workersCount + 1, 0);
+        for (size_t worker = 0; worker < workersCount; ++worker)
+        {
+            workerOffsets[worker + 1] = workerOffsets[worker] + static_cast<uint32_t>(workerTargets[worker].size());
+        }
+        table.inputs.resize(workerOffsets.back());
+        table.targets.resize(workerOffsets.back());
+
+        RunByRanges(pool, statesCount, [&](const size_t worker, const size_t begin, const size_t end) {
+            const uint32_t offset = workerOffsets[worker];
+            for (size_t state = begin; state < end; ++state)
+            {
+                table.rowOffsets[state + 1] += offset;
+            }
+            std::ranges::copy(workerInputs[worker], table.inputs.begin() + offset);
+            std::ranges::copy(workerTargets[worker], table.targets.begin() + offset);
+            StateArray().swap(workerInputs[worker]);
+            StateArray().swap(workerTargets[worker]);
+        });
+
+        return table;
+    }
+};
+
+namespace SparsePartition
+{
+    constexpr uint32_t NO_BLOCK = std::numeric_limits<uint32_t>::max();
+    // worklist engines have no rounds, their traces sample the partition every this many worklist items
+    constexpr size_t TRACE_SAMPLE_INTERVAL = 1024;
+
+    struct SignatureView
+    {
+        const uint32_t* data;
+        size_t size;
+
+        bool operator==(const SignatureView& other) const
+        {
+            return size == other.size && SimdRows::AreEqual(data, other.data, size);
+        }
+    };
+
+    struct SignatureViewHash
+    {
+        size_t operator()(const SignatureView& view) const
+        {
+            return static_cast<size_t>(SimdRows::Hash(view.data, view.size));
+        }
+    };
+
+    inline uint32_t GetBlocksCount(const std::vector<uint32_t>& blocks)
+    {
+        uint32_t count = 0;
+        for (auto block: blocks)
+        {
+            count = std::max(count, block + 1);
+        }
+
+        return count;
+    }
+
+    // Splits the blocks until all states of a block have transitions on the same inputs into the same blocks.
+    // A missing transition is equal only to a missing one, so a partial automata is never completed with a sink.
+    // Only blocks on the worklist are examined: a block is queued again only when a successor of one of
+    // its states moved to a new block, so the last rounds of a converging refinement cost almost nothing
+    inline std::vector<uint32_t> Refine(const SparseTransitionTable& table, std::vector<uint32_t> blocks,
+        WorkerPool* pool = nullptr)
+    {
+        MMM_TRACE_SCOPE("RefineIterative");
+        const auto predecessors = table.GetReversed(pool);
+
+        uint32_t blocksCount = GetBlocksCount(blocks);
+        std::vector<std::vector<uint32_t>> blockStates(blocksCount);
+        for (uint32_t state = 0; state < blocks.size(); ++state)
+        {
+            blockStates[blocks[state]].push_back(state);
+        }
+
+        std::vector<uint32_t> worklist(blocksCount);
+        std::iota(worklist.begin(), worklist.end(), 0);
+        std::vector<bool> isQueued(blocksCount, true);
+
+        // signature of a state: the inputs of its transitions, then their target blocks
+        std::vector<uint32_t> signatures;
+        std::vector<size_t> signatureOffsets;
+        std::unordered_map<SignatureView, uint32_t, SignatureViewHash> signatureToGroup;
+        std::vector<uint32_t> stateGroups;
+        std::vector<size_t> groupSizes;
+        size_t examinedCount = 0;
+        [[maybe_unused]] size_t splitsCount = 0;
+
+        while (!worklist.empty())
+        {
+            if (examinedCount++ % TRACE_SAMPLE_INTERVAL == 0)
+            {
+                MMM_TRACE_COUNTER("blocks", blocksCount);
+                MMM_TRACE_COUNTER("worklist", worklist.size());
+            }
+
+            const uint32_t block = worklist.back();
+            worklist.pop_back();
+            isQueued[block] = false;
+
+            if (blockStates[block].size() <= 1)
+            {
+                continue;
+            }
+
+            signatures.clear();
+            signatureOffsets.clear();
+            for (auto state: blockStates[block])
+            {
+                const size_t offset = signatures.size();
+                const auto rowBegin = table.rowOffsets[state];
+                const size_t rowSize = table.rowOffsets[state + 1] - rowBegin;
+                signatureOffsets.push_back(offset);
+                signatures.resize(offset + 2 * rowSize);
+                std::copy_n(table.inputs.data() + rowBegin, rowSize, signatures.data() + offset);
+                SimdRows::Gather(blocks.data(), table.targets.data() + rowBegin, rowSize,
+                    signatures.data() + offset + rowSize);
+            }
+            signatureOffsets.push_back(signatures.size());
+
+            signatureToGroup.clear();
+            stateGroups.clear();
+            groupSizes.clear();
+            for (size_t i = 0; i + 1 < signatureOffsets.size(); ++i)
+            {
+                SignatureView view { signatures.data() + signatureOffsets[i], signatureOffsets[i + 1] - signatureOffsets[i] };
+                auto [it, isNew] = signatureToGroup.emplace(view, static_cast<uint32_t>(groupSizes.size()));
+                if (isNew)
+                {
+                    groupSizes.push_back(0);
+                }
+                ++groupSizes[it->second];
+                stateGroups.push_back(it->second);
+            }
+
+            if (groupSizes.size() == 1)
+            {
+                continue;
+            }
+
+            // the largest group keeps the block, the others become new blocks
+            ++splitsCount;
+            const auto largestGroup = static_cast<uint32_t>(std::ranges::max_element(groupSizes) - groupSizes.begin());
+            std::vector<uint32_t> groupBlocks(groupSizes.size());
+            for (uint32_t group = 0; group < groupSizes.size(); ++group)
+            {
+                groupBlocks[group] = group == largestGroup ? block : blocksCount++;
+            }
+            blockStates.resize(blocksCount);
+            isQueued.resize(blocksCount, false);
+
+            std::vector<uint32_t> states = std::move(blockStates[block]);
+            blockStates[block].clear();
+            for (size_t i = 0; i < states.size(); ++i)
+            {
+                const uint32_t newBlock = groupBlocks[stateGroups[i]];
+                blockStates[newBlock].push_back(states[i]);
+                blocks[states[i]] = newBlock;
+            }
+
+            // signatures change only for the predecessors of the moved states
+            for (size_t i = 0; i < states.size(); ++i)
+            {
+                if (stateGroups[i] == largestGroup)
+                {
+                    continue;
+                }
+
+                const uint32_t state = states[i];
+                for (auto j = predecessors.rowOffsets[state]; j < predecessors.rowOffsets[state + 1]; ++j)
+                {
+                    const uint32_t predecessorBlock = blocks[predecessors.targets[j]];
+                    if (!isQueued[predecessorBlock])
+                    {
+                        isQueued[predecessorBlock] = true;
+                        worklist.push_back(predecessorBlock);
+                    }
+                }
+            }
+        }
+
+        MMM_TRACE_COUNTER("blocks", blocksCount);
+        MMM_TRACE_INSTANT("Refined", Trace::Args()
+            .Add("examined", examinedCount).Add("split", splitsCount).Add("blocks", blocksCount).Get());
+        return blocks;
+    }
+
+    // Numbers the blocks of a partition for export: the block of the start state (state 0) gets 0,
+    // the others follow in order of their first state. Returns block -> new index and new index -> representative state
+    inline std::pair<std::vector<uint32_t>, std::vector<uint32_t>> GetBlockRepresentatives(
+        const std::vector<uint32_t>& blocks)
+    {
+        std::vector<uint32_t> newIndexes(GetBlocksCount(blocks), NO_BLOCK);
+        std::vector<uint32_t> representatives;
+
+        for (uint32_t state = 0; state < blocks.size(); ++state)
+        {
+            if (newIndexes[blocks[state]] == NO_BLOCK)
+            {
+                newIndexes[blocks[state]] = static_cast<uint32_t>(representatives.size());
+                representatives.push_back(state);
+            }
+        }
+
+        return { std::move(newIndexes), std::move(representatives) };
+    }
+}
+
+#endif
@@ -1,21 +1,66 @@
 #pragma once
 #include <fstream>
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
 
 #include "ArgumentsParser.h"
 #include "Automata/MealyAutomata.h"
 #include "Automata/MooreAutomata.h"
+#include "Utils/ChunkedIo.h"
+#include "Utils/CompressedIo.h"
+#include "Utils/Trace.h"
+
+// Files are read in binary mode for compression detection, so CRLF line ends are handled here
+inline std::istream& ReadLine(std::istream& input, std::string& line)
+{
+    if (std::getline(input, line) && line.ends_with('\r'))
+    {
+        line.pop_back();
+    }
+
+    return input;
+}
+
+// Calls visit(field) for every ';' separated field of the line, a cell per field without copying the line
+template <typename Visit>
+void ForEachField(const std::string_view line, Visit&& visit)
+{
+    size_t begin = 0;
+    while (begin <= line.size())
+    {
+        size_t end = line.find(';', begin);
+        if (end == std::string_view::npos)
+        {
+            end = line.size();
+        }
+        visit(line.substr(begin, end - begin));
+        begin = end + 1;
+    }
+}
+
+// Detects gzip and zstd by magic bytes, decompression runs on its own thread while the rows are parsed
+template <typename Loader>
+auto GetAutomataFromByteSource(IByteSource& source, Loader&& load)
+{
+    auto decompressed = OpenDecompressedSource(source);
+    ChunkedInputBuffer buffer(*decompressed);
+    std::istream input(&buffer);
+    input.exceptions(std::ios::badbit);
+
+    return load(input);
+}
 
 namespace MealyController
 {
-    inline std::vector<std::string> GetStatesFromFile(std::ifstream& inputFile)
+    inline std::vector<std::string> GetStatesFromFile(std::istream& inputFile)
     {
         std::vector<std::string> states;
 
         std::string line;
-        std::getline(inputFile, line);
+        ReadLine(inputFile, line);
 
         std::stringstream ss(line);
         std::string state;
@@ -30,57 +75,56 @@ namespace MealyController
         return states;
     }
 
-    inline MealyTransitionTable GetTransitionsFromFile(std::ifstream& inputFile, std::vector<std::string>& states)
+    // Only defined transitions are kept, rows are merged into input classes as they are read,
+    // so neither a large alphabet nor a sparse table costs states * inputs cells
+    inline void GetTransitionsFromFile(std::istream& inputFile, AutomataTableBuilder& builder)
     {
-        MealyTransitionTable transitionTable;
-
         std::string line;
-        while (std::getline(inputFile, line))
+        while (ReadLine(inputFile, line))
         {
-            std::stringstream ss(line);
-            std::string inputSymbol;
-            std::getline(ss, inputSymbol, ';');
-
-            std::vector<Transition> transitions;
+            InputSymbol inputSymbol;
+            TransitionColumn transitions;
+            size_t field = 0;
+            ForEachField(line, [&](const std::string_view transitionData) {
+                if (field++ == 0)
+                {
+                    inputSymbol = transitionData;
+                    return;
+                }
 
-            for (const auto& state : states)
-            {
-                std::string transitionData;
-                if (std::getline(ss, transitionData, ';'))
+                // a cell without '/' is an undefined transition
+                const auto state = static_cast<uint32_t>(field - 2);
+                const size_t separatorPos = transitionData.find('/');
+                if (state < builder.GetStatesCount() && separatorPos != std::string_view::npos && separatorPos != 0)
                 {
-                    size_t separatorPos = transitionData.find('/');
-                    if (separatorPos != std::string::npos)
-                    {
-                        std::string nextState = transitionData.substr(0, separatorPos);
-                        std::string output = transitionData.substr(separatorPos + 1);
-
-                        transitions.emplace_back(nextState, output);
-                    }
+                    transitions.push_back({ state, builder.GetStateIndex(transitionData.substr(0, separatorPos)),
+                        builder.GetOutputId(transitionData.substr(separatorPos + 1)) });
                 }
-            }
+            });
 
-            transitionTable.emplace_back(inputSymbol, transitions);
+            builder.AddInput(std::move(inputSymbol), std::move(transitions));
         }
+    }
 
-        return transitionTable;
+    inline std::unique_ptr<MealyAutomata> GetMealyAutomataFromCsv(std::istream& input)
+    {
+        AutomataTableBuilder builder(GetStatesFromFile(input));
+        GetTransitionsFromFile(input, builder);
+
+        return std::make_unique<MealyAutomata>(builder.Release(true));
     }
 
     inline std::unique_ptr<MealyAutomata> GetMealyAutomataFromCsvFile(const std::string &inputFilename)
     {
-        std::ifstream input(inputFilename);
+        std::ifstream input(inputFilename, std::ios::binary);
         if (!input.is_open())
         {
             std::string message = "File \"" + inputFilename + "\" not found";
             throw std::runtime_error(message);
         }
 
-        std::vector<std::string> states = GetStatesFromFile(input);
-        MealyTransitionTable transitions = GetTransitionsFromFile(input, states);
-
-        input.close();
-
-        MealyAutomata mealy(std::move(states), std::move(transitions));
-        return std::make_unique<MealyAutomata>(mealy);
+        StreamByteSource source(input);
+        return GetAutomataFromByteSource(source, GetMealyAutomataFromCsv);
     }
 }
 
@@ -90,7 +134,7 @@ namespace MooreController
     {
         std::vector<std::string> outputSymbols;
 
-        if (std::string line; std::getline(input, line))
+        if (std::string line; ReadLine(input, line))
         {
             std::stringstream ss(line);
             std::string outputSymbol;
@@ -110,68 +154,114 @@ namespace MooreController
         return outputSymbols;
     }
 
-    inline MooreStatesInfo GetStatesFromFile(std::istream& input, const std::vector<std::string>& outputSymbols)
+    // The states line, every named state takes the next output of the outputs line
+    inline AutomataTableBuilder GetStatesFromFile(std::istream& input, const std::vector<std::string>& outputSymbols)
     {
-        MooreStatesInfo states;
+        std::vector<State> states;
         std::string line;
 
-        if (std::getline(input, line))
+        if (ReadLine(input, line))
         {
-            size_t index = 0;
             std::stringstream ss(line);
             std::string state;
             while (std::getline(ss, state, ';'))
             {
                 if (!state.empty())
                 {
-                    states.emplace_back(state, outputSymbols.at(index++));
+                    states.push_back(state);
                 }
             }
         }
 
-        return states;
+        AutomataTableBuilder builder(std::move(states));
+        for (size_t index = 0; index < builder.GetStatesCount(); ++index)
+        {
+            builder.AddStateOutput(outputSymbols.at(index));
+        }
+
+        return builder;
     }
 
-    inline std::unique_ptr<MooreAutomata> GetMooreAutomataFromCsvFile(const std::string& filename)
+    inline std::unique_ptr<MooreAutomata> GetMooreAutomataFromCsv(std::istream& file)
     {
-        std::list<std::pair<std::string, std::vector<std::string>>> transitionTable;
+        const std::vector<std::string> outputSymbols = GetOutputSymbolsFromFile(file);
+        AutomataTableBuilder builder = GetStatesFromFile(file, outputSymbols);
 
-        std::vector<std::string> inputSymbols;
-        std::vector<std::string> outputSymbols;
-        MooreStatesInfo states;
+        std::string line;
+        while (ReadLine(file, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
 
-        std::ifstream file(filename);
+            InputSymbol inputSymbol;
+            TransitionColumn transitions;
+            size_t field = 0;
+            ForEachField(line, [&](const std::string_view transition) {
+                if (field++ == 0)
+                {
+                    inputSymbol = transition;
+                    return;
+                }
+
+                // empty cells are undefined transitions
+                const auto state = static_cast<uint32_t>(field - 2);
+                if (state < builder.GetStatesCount() && !transition.empty())
+                {
+                    transitions.push_back({ state, builder.GetStateIndex(transition), 0 });
+                }
+            });
+            builder.AddInput(std::move(inputSymbol), std::move(transitions));
+        }
+
+        return std::make_unique<MooreAutomata>(builder.Release(false));
+    }
+
+    inline std::unique_ptr<MooreAutomata> GetMooreAutomataFromCsvFile(const std::string& filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
         if (!file.is_open())
         {
             throw std::runtime_error("Could not open the file.");
         }
 
-        std::string line;
+        StreamByteSource source(file);
+        return GetAutomataFromByteSource(source, GetMooreAutomataFromCsv);
+    }
+}
 
-        outputSymbols = GetOutputSymbolsFromFile(file);
+inline std::unique_ptr<IAutomata> GetAutomataFromCsv(const Automata automata, std::istream& input)
+{
+    if (automata == Automata::Mealy)
+    {
+        return MealyController::GetMealyAutomataFromCsv(input);
+    }
 
-        states = GetStatesFromFile(file, outputSymbols);
+    return MooreController::GetMooreAutomataFromCsv(input);
+}
 
-        while (std::getline(file, line))
+// "-" reads stdin in chunks, rows are parsed while the rest of the table is still arriving.
+// Both stdin and files may be gzip or zstd compressed
+inline std::unique_ptr<IAutomata> GetAutomataFromCsvFile(const Automata automata, const std::string& filename)
+{
+    MMM_TRACE_SCOPE("LoadAutomata");
+    if (filename != STANDARD_STREAM)
+    {
+        if (automata == Automata::Mealy)
         {
-            std::stringstream ss(line);
-            std::string inputSymbol;
-            if (std::getline(ss, inputSymbol, ';'))
-            {
-                std::vector<std::string> stateTransitions;
-                std::string transition;
-                while (std::getline(ss, transition, ';'))
-                {
-                    if (!transition.empty())
-                    {
-                        stateTransitions.push_back(transition);
-                    }
-                }
-                inputSymbols.push_back(inputSymbol);
-                transitionTable.emplace_back(inputSymbol, stateTransitions);
-            }
+            return MealyController::GetMealyAutomataFromCsvFile(filename);
         }
-        MooreAutomata mooreAutomata(std::move(inputSymbols), std::move(states), std::move(transitionTable));
-        return std::make_unique<MooreAutomata>(mooreAutomata);
+
+        return MooreController::GetMooreAutomataFromCsvFile(filename);
     }
-}
\ No newline at end of file
+
+#ifdef _WIN32
+    StreamByteSource source(std::cin);
+#else
+    FileDescriptorByteSource source(STDIN_FILENO);
+#endif
+    return GetAutomataFromByteSource(source, [automata](std::istream& input) {
+        return GetAutomataFromCsv(automata, input);
+    });
+}
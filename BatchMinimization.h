@@ -0,0 +1,253 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ArgumentsParser.h"
+#include "AutomataController.h"
+#include "Minimization.h"
+#include "ResultCache.h"
+#include "Utils/AsyncFileIo.h"
+#include "Utils/ThreadPool.h"
+#include "Utils/Trace.h"
+
+// Minimizes many files in one run. Reads are kept in flight by the asynchronous file I/O, every file read
+// is parsed and minimized by a pool worker, and its result is written asynchronously while the next files
+// are parsed, so the workers wait on the disk only when all of them are idle anyway.
+// Files are minimized one per worker, the parallel refinement of a single large file is not used.
+// A file that fails does not stop the others, the run fails at the end.
+// Outputs keep the file names of their inputs, so the output directory must not hold any of the inputs
+class BatchMinimization
+{
+public:
+    explicit BatchMinimization(const Args& args)
+        : m_args(args)
+    {
+        const auto outputDirectory = std::filesystem::weakly_canonical(
+            std::filesystem::absolute(m_args.outputDirectory));
+        std::set<std::string> outputNames;
+        for (auto& input: m_args.inputFilenames)
+        {
+            const auto name = std::filesystem::path(input).filename();
+            if (name.empty() || !outputNames.insert(name.string()).second)
+            {
+                throw std::invalid_argument("Batch input " + input + " has no unique file name for its output");
+            }
+            if (std::filesystem::weakly_canonical(std::filesystem::absolute(input).parent_path()) == outputDirectory)
+            {
+                throw std::invalid_argument("Batch output directory " + m_args.outputDirectory
+                    + " holds input " + input + ", its output would replace it");
+            }
+            m_outputFilenames.push_back((std::filesystem::path(m_args.outputDirectory) / name).string());
+        }
+    }
+
+    void Run(std::ostream& messages)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::error_code error;
+        std::filesystem::create_directories(m_args.outputDirectory, error);
+        if (error)
+        {
+            throw std::runtime_error("Could not create output directory " + m_args.outputDirectory);
+        }
+        if (!m_args.cacheDirectory.empty())
+        {
+            m_cache = std::make_unique<ResultCache>(m_args.cacheDirectory, m_args.cacheSize);
+        }
+        m_results.assign(m_args.inputFilenames.size(), {});
+
+        std::string ioName;
+        {
+            // the I/O outlives the workers: a worker's last act is to start the write of its result
+            const auto io = CreateAsyncFileIo();
+            ThreadPool workers(m_args.threadsCount);
+            ioName = io->GetName();
+
+            for (size_t i = 0; i < m_args.inputFilenames.size(); ++i)
+            {
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_condition.wait(lock, [this] { return m_filesInFlight < IAsyncFileIo::QUEUE_DEPTH; });
+                    ++m_filesInFlight;
+                }
+
+                io->Read(m_args.inputFilenames[i], [this, i, &io, &workers](std::string data, std::exception_ptr error) {
+                    if (error)
+                    {
+                        Finish(i, error);
+                        return;
+                    }
+                    m_results[i].readSize = data.size();
+                    // futures of the pools are dropped, so nothing may escape a callback or a task:
+                    // every file ends in Finish
+                    try
+                    {
+                        workers.Submit([this, i, &io, data = std::move(data)] {
+                            try
+                            {
+                                std::string output = Process(i, data);
+                                m_results[i].writeSize = output.size();
+                                io->Write(m_outputFilenames[i], std::move(output), [this, i](std::exception_ptr error) {
+                                    Finish(i, error);
+                                });
+                            }
+                            catch (...)
+                            {
+                                Finish(i, std::current_exception());
+                            }
+                        });
+                    }
+                    catch (...)
+                    {
+                        Finish(i, std::current_exception());
+                    }
+                });
+            }
+
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_filesInFlight == 0; });
+        }
+
+        size_t failedCount = 0;
+        for (size_t i = 0; i < m_results.size(); ++i)
+        {
+            if (m_results[i].error)
+            {
+                messages << m_args.inputFilenames[i] << ": " << *m_results[i].error << '\n';
+                ++failedCount;
+            }
+            else if (m_results[i].canonicalHash)
+            {
+                messages << m_args.inputFilenames[i] << ": canonical hash " << *m_results[i].canonicalHash << '\n';
+            }
+        }
+        if (m_args.stats)
+        {
+            PrintStats(messages, ioName, std::chrono::steady_clock::now() - start);
+        }
+
+        if (failedCount != 0)
+        {
+            throw std::runtime_error(std::to_string(failedCount) + " of " + std::to_string(m_results.size())
+                + " files failed");
+        }
+    }
+
+private:
+    struct Result
+    {
+        size_t readSize = 0;
+        size_t writeSize = 0;
+        std::optional<std::string> canonicalHash;
+        std::optional<std::string> error;
+    };
+
+    // Returns the output file contents, compressed as the output file name asks
+    std::string Process(const size_t index, const std::string& data)
+    {
+        MMM_TRACE_SCOPE("BatchFile");
+        MemoryByteSource source(data);
+        auto automata = GetAutomataFromByteSource(source, [this](std::istream& input) {
+            return GetAutomataFromCsv(m_args.automata, input);
+        });
+
+        const auto compression = GetCompressionByExtension(m_outputFilenames[index]);
+        std::ostringstream output;
+        std::string cacheKey;
+        if (m_cache)
+        {
+            cacheKey = GetCacheKey(*automata, m_args);
+            if (const auto cached = m_cache->Load(cacheKey))
+            {
+                m_results[index].canonicalHash = cached->canonicalHash;
+                WriteCompressed(output, compression, [&](std::ostream& stream) { stream << cached->csv; });
+                return output.str();
+            }
+        }
+
+        m_results[index].canonicalHash = MinimizeAutomata(*automata, m_args);
+        if (!m_cache)
+        {
+            WriteCompressed(output, compression, [&](std::ostream& stream) { automata->WriteCsv(stream); });
+            return output.str();
+        }
+
+        // the output and the cache entry share one serialization, a plain output is the CSV itself
+        std::ostringstream csv;
+        automata->WriteCsv(csv);
+        CachedResult result = { std::move(csv).str(), m_results[index].canonicalHash };
+        m_cache->Store(cacheKey, result);
+        if (compression == Compression::None)
+        {
+            return std::move(result.csv);
+        }
+
+        WriteCompressed(output, compression, [&](std::ostream& stream) { stream << result.csv; });
+        return output.str();
+    }
+
+    void Finish(const size_t index, const std::exception_ptr& error)
+    {
+        if (error)
+        {
+            try
+            {
+                std::rethrow_exception(error);
+            }
+            catch (const std::exception& err)
+            {
+                m_results[index].error = err.what();
+            }
+            catch (...)
+            {
+                m_results[index].error = "Unknown error";
+            }
+        }
+
+        {
+            std::lock_guard lock(m_mutex);
+            --m_filesInFlight;
+        }
+        m_condition.notify_all();
+    }
+
+    void PrintStats(std::ostream& output, const std::string& ioName, const std::chrono::steady_clock::duration time) const
+    {
+        size_t readSize = 0;
+        size_t writeSize = 0;
+        for (auto& result: m_results)
+        {
+            readSize += result.readSize;
+            writeSize += result.writeSize;
+        }
+        const double seconds = std::chrono::duration<double>(time).count();
+
+        output << std::fixed << std::setprecision(2)
+            << "Files: " << m_results.size() << ", I/O: " << ioName
+            << ", read: " << static_cast<double>(readSize) / 1e6 << " MB"
+            << ", written: " << static_cast<double>(writeSize) / 1e6 << " MB" << '\n'
+            << "Time: " << seconds * 1000 << " ms, " << static_cast<double>(m_results.size()) / seconds << " files/s, "
+            << static_cast<double>(readSize) / 1e6 / seconds << " MB/s" << std::endl;
+    }
+
+    const Args& m_args;
+    std::vector<std::string> m_outputFilenames;
+    std::unique_ptr<ResultCache> m_cache;
+    // every result is written by the one thread handling its file at the time
+    std::vector<Result> m_results;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    size_t m_filesInFlight = 0;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <string>
+
+#include "ArgumentsParser.h"
+#include "Automata/IAutomata.h"
+#include "Utils/Sha256.h"
+
+// Key of a minimization result: the options that change the output and the canonical hash of the parsed automata
+inline std::string GetCacheKey(const IAutomata& automata, const Args& args)
+{
+    Sha256 hash;
+    // entry format version, entries written in an older format are never looked up
+    hash.Update("2;");
+    hash.Update(args.automata == Automata::Mealy ? MEALY : MOORE);
+    hash.Update(';');
+    hash.Update(args.canonical ? CANONICAL_OPTION : "");
+    hash.Update(';');
+    if (args.dontCareOutput)
+    {
+        hash.Update(*args.dontCareOutput);
+        hash.Update(';');
+        hash.Update(std::to_string(static_cast<int>(args.dontCareMode)));
+    }
+    hash.Update(';');
+    hash.Update(automata.GetCanonicalHash());
+
+    return hash.HexDigest();
+}
+
+// Minimizes the automata as the options ask, returns the canonical hash if canonical form was requested.
+// Statistics are filled by exact minimization only, don't care minimization has its own engine
+inline std::optional<std::string> MinimizeAutomata(IAutomata& automata, const Args& args,
+    PartitionAlgorithm::Stats* stats = nullptr)
+{
+    if (args.dontCareOutput)
+    {
+        automata.MinimizeWithDontCare(*args.dontCareOutput, args.dontCareMode);
+    }
+    else
+    {
+        auto minimizationStats = automata.Minimize(args.algorithm);
+        if (stats)
+        {
+            *stats = minimizationStats;
+        }
+    }
+
+    if (args.canonical)
+    {
+        automata.Canonicalize();
+        return automata.GetCanonicalHash();
+    }
+
+    return std::nullopt;
+}
+
+inline void PrintStats(std::ostream& output, const PartitionAlgorithm::Stats& stats, const Args& args)
+{
+    output << std::fixed << std::setprecision(2)
+        << "Algorithm: " << PartitionAlgorithm::GetAlgorithmName(stats.algorithm)
+        << (args.algorithm == PartitionAlgorithm::Algorithm::Auto ? " (auto)" : "")
+        << (stats.fallback ? ", fell back to " + PartitionAlgorithm::GetAlgorithmName(*stats.fallback) : "") << '\n'
+        << "States: " << stats.statesCount << ", inputs: " << stats.inputsCount
+        << ", transitions: " << stats.transitionsCount << ", density: " << stats.density
+        << ", initial blocks: " << stats.initialBlocksCount << ", blocks: " << stats.blocksCount
+        << ", workers: " << stats.workersCount << '\n'
+        << "Prepare: " << stats.prepareMs << " ms, refine: " << stats.refineMs
+        << " ms, build: " << stats.buildMs << " ms" << std::endl;
+}
@@ -0,0 +1,488 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "ArgumentsParser.h"
+#include "AutomataController.h"
+#include "Minimization.h"
+#include "ResultCache.h"
+#include "Utils/ThreadPool.h"
+
+// Long-running minimization service on a Unix domain socket.
+// A request is a header line "<mealy|moore> <size> [options]" followed by <size> bytes of CSV,
+// a connection may pipeline any number of requests. Responses are sent in request order:
+// "OK <size>[ <canonical hash>]" or "ERROR <size>" followed by <size> bytes of CSV or of the error message.
+// SIGINT or SIGTERM stops accepting, answers the requests already read and removes the socket
+class MinimizationServer
+{
+public:
+    explicit MinimizationServer(const Args& args)
+        : m_socketPath(args.socketPath),
+        m_pool(args.threadsCount),
+        m_cache(args.cacheSize),
+        m_maxRequestSize(args.maxRequestSize),
+        m_maxConnections(args.maxConnections)
+    {}
+
+#ifdef _WIN32
+    void Run()
+    {
+        throw std::runtime_error("Server mode is not supported on this platform");
+    }
+#else
+    void Run()
+    {
+        std::signal(SIGPIPE, SIG_IGN);
+
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        if (m_socketPath.size() >= sizeof(address.sun_path))
+        {
+            throw std::invalid_argument("Socket path " + m_socketPath + " is too long");
+        }
+        m_socketPath.copy(address.sun_path, m_socketPath.size());
+        RemoveStaleSocket();
+
+        const int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0)
+        {
+            throw std::runtime_error("Could not create socket");
+        }
+
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, SOMAXCONN) < 0)
+        {
+            close(listenFd);
+            throw std::runtime_error("Could not listen on socket " + m_socketPath);
+        }
+        if (pipe(s_stopPipe) < 0)
+        {
+            close(listenFd);
+            unlink(m_socketPath.c_str());
+            throw std::runtime_error("Could not create the stop pipe");
+        }
+
+        struct sigaction action {};
+        action.sa_handler = OnStopSignal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        // a signal handler can only write to the pipe, this thread does the rest: shutting the listening
+        // socket wakes accept, shutting the read side of a connection lets it answer what it has read and end
+        std::thread stopper([this, listenFd] {
+            char byte = 0;
+            while (read(s_stopPipe[0], &byte, 1) < 0 && errno == EINTR)
+            {
+            }
+
+            std::lock_guard lock(m_connectionsMutex);
+            m_isStopping = true;
+            shutdown(listenFd, SHUT_RDWR);
+            for (const int fd: m_connectionFds)
+            {
+                shutdown(fd, SHUT_RD);
+            }
+            m_connectionsCondition.notify_all();
+        });
+
+        std::cout << "Listening on " << m_socketPath << " with " << m_pool.GetThreadsCount() << " workers" << std::endl;
+
+        std::exception_ptr error;
+        try
+        {
+            AcceptConnections(listenFd);
+        }
+        catch (const std::exception&)
+        {
+            error = std::current_exception();
+        }
+
+        // without a signal the stopper is still waiting
+        OnStopSignal(0);
+        stopper.join();
+        WaitForConnections();
+
+        close(listenFd);
+        unlink(m_socketPath.c_str());
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        close(s_stopPipe[0]);
+        close(s_stopPipe[1]);
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+#endif
+
+private:
+    static constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_HEADER_SIZE = 4096;
+    // requests of one connection read but not yet answered, a client that pipelines faster than the pool
+    // works waits with the rest of its requests in the socket
+    static constexpr size_t MAX_PENDING_RESPONSES = 64;
+
+    struct Request
+    {
+        Args args;
+        std::string csv;
+    };
+
+#ifndef _WIN32
+    // SIGINT and SIGTERM write to this pipe, the stopper thread of Run reads it
+    static inline int s_stopPipe[2] = { -1, -1 };
+
+    static void OnStopSignal(int)
+    {
+        const int savedErrno = errno;
+        const char byte = 0;
+        [[maybe_unused]] const auto written = write(s_stopPipe[1], &byte, 1);
+        errno = savedErrno;
+    }
+
+    // A socket left by a server that was killed is replaced, any other file at the path is an error
+    void RemoveStaleSocket() const
+    {
+        struct stat status {};
+        if (lstat(m_socketPath.c_str(), &status) < 0)
+        {
+            if (errno == ENOENT)
+            {
+                return;
+            }
+            throw std::runtime_error("Could not check socket path " + m_socketPath);
+        }
+        if (!S_ISSOCK(status.st_mode))
+        {
+            throw std::invalid_argument("Socket path " + m_socketPath + " exists and is not a socket");
+        }
+
+        unlink(m_socketPath.c_str());
+    }
+
+    // Returns when the server stops
+    void AcceptConnections(const int listenFd)
+    {
+        while (true)
+        {
+            {
+                std::unique_lock lock(m_connectionsMutex);
+                m_connectionsCondition.wait(lock, [this] {
+                    return m_isStopping || m_connectionFds.size() < m_maxConnections;
+                });
+                if (m_isStopping)
+                {
+                    return;
+                }
+            }
+
+            const int connectionFd = accept(listenFd, nullptr, nullptr);
+            if (connectionFd < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+
+                std::lock_guard lock(m_connectionsMutex);
+                if (m_isStopping)
+                {
+                    return;
+                }
+                throw std::runtime_error("Could not accept connection");
+            }
+
+            {
+                std::lock_guard lock(m_connectionsMutex);
+                if (m_isStopping)
+                {
+                    close(connectionFd);
+                    return;
+                }
+                m_connectionFds.insert(connectionFd);
+            }
+            try
+            {
+                std::thread([this, connectionFd] {
+                    ServeConnection(connectionFd);
+                    EndConnection(connectionFd);
+                }).detach();
+            }
+            catch (const std::system_error&)
+            {
+                EndConnection(connectionFd);
+            }
+        }
+    }
+
+    // The descriptor is closed under the lock, so the stopper never shuts a number that was reused
+    void EndConnection(const int fd)
+    {
+        {
+            std::lock_guard lock(m_connectionsMutex);
+            m_connectionFds.erase(fd);
+            close(fd);
+        }
+        m_connectionsCondition.notify_all();
+    }
+
+    // Connection threads are detached but counted, Run leaves only when none of them uses the server
+    void WaitForConnections()
+    {
+        std::unique_lock lock(m_connectionsMutex);
+        m_connectionsCondition.wait(lock, [this] { return m_connectionFds.empty(); });
+    }
+#endif
+
+    static std::string FormatResponse(const std::string& status, const std::string& body,
+        const std::optional<std::string>& hash = std::nullopt)
+    {
+        std::string response = status + ' ' + std::to_string(body.size());
+        if (hash)
+        {
+            response += ' ' + *hash;
+        }
+
+        return response + '\n' + body;
+    }
+
+    static Args ParseHeader(const std::string& header, size_t& size)
+    {
+        std::istringstream ss(header);
+        std::string automata, sizeStr;
+        ss >> automata >> sizeStr;
+
+        Args args {};
+        args.automata = ParseAutomata(automata);
+        size = ParseSizeOption("size ", sizeStr);
+
+        for (std::string option; ss >> option;)
+        {
+            if (!ParseOption(args, option))
+            {
+                throw std::invalid_argument("Invalid request option " + option);
+            }
+            // the cache, the pool and the trace belong to the server process, a client cannot change them
+            if (!IsRequestOption(option))
+            {
+                throw std::invalid_argument("Option " + option + " is not supported in requests");
+            }
+        }
+
+        return args;
+    }
+
+    // Options that change the result of a single request
+    static bool IsRequestOption(const std::string& option)
+    {
+        return option == CANONICAL_OPTION
+            || option.starts_with(DONT_CARE_OPTION)
+            || option.starts_with(DONT_CARE_MODE_OPTION)
+            || option.starts_with(ALGORITHM_OPTION);
+    }
+
+    std::string Process(const Request& request)
+    {
+        try
+        {
+            std::istringstream input(request.csv);
+            auto automata = GetAutomataFromCsv(request.args.automata, input);
+
+            const auto key = GetCacheKey(*automata, request.args);
+            if (auto cached = m_cache.Load(key))
+            {
+                return FormatResponse("OK", cached->csv, cached->canonicalHash);
+            }
+
+            auto hash = MinimizeAutomata(*automata, request.args);
+
+            std::ostringstream output;
+            automata->WriteCsv(output);
+
+            MemoryResultCache::Result result = { output.str(), hash };
+            m_cache.Store(key, result);
+
+            return FormatResponse("OK", result.csv, result.canonicalHash);
+        }
+        catch (const std::exception& err)
+        {
+            return FormatResponse("ERROR", err.what());
+        }
+    }
+
+#ifndef _WIN32
+    static bool SendAll(const int fd, const std::string& data)
+    {
+        for (size_t sent = 0; sent < data.size();)
+        {
+            const auto count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return false;
+            }
+            sent += count;
+        }
+
+        return true;
+    }
+
+    // The reader splits incoming data into requests and hands each of them to the pool as a task of its own,
+    // so pipelined requests run in parallel. The writer sends the responses back in request order
+    // as soon as they are ready
+    void ServeConnection(const int fd)
+    {
+        std::queue<std::future<std::string>> responses;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool isReadDone = false;
+
+        auto pushResponse = [&](std::future<std::string> response) {
+            {
+                std::unique_lock lock(mutex);
+                condition.wait(lock, [&] { return responses.size() < MAX_PENDING_RESPONSES; });
+                responses.push(std::move(response));
+            }
+            condition.notify_all();
+        };
+
+        std::thread writer([&] {
+            bool isConnected = true;
+            while (true)
+            {
+                std::future<std::string> response;
+                {
+                    std::unique_lock lock(mutex);
+                    condition.wait(lock, [&] { return isReadDone || !responses.empty(); });
+                    if (responses.empty())
+                    {
+                        return;
+                    }
+                    response = std::move(responses.front());
+                    responses.pop();
+                }
+                condition.notify_all();
+
+                const std::string data = response.get();
+                isConnected = isConnected && SendAll(fd, data);
+            }
+        });
+
+        std::string buffer;
+        std::vector<char> chunk(READ_CHUNK_SIZE);
+        bool isFailed = false;
+
+        while (!isFailed)
+        {
+            const auto count = read(fd, chunk.data(), chunk.size());
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                break;
+            }
+            buffer.append(chunk.data(), count);
+
+            std::vector<Request> requests;
+            std::optional<std::string> error;
+            size_t pos = 0;
+            while (true)
+            {
+                const size_t headerEnd = buffer.find('\n', pos);
+                if (headerEnd == std::string::npos)
+                {
+                    if (buffer.size() - pos > MAX_HEADER_SIZE)
+                    {
+                        error = "Request header is too long";
+                    }
+                    break;
+                }
+
+                size_t size = 0;
+                Args args;
+                try
+                {
+                    args = ParseHeader(buffer.substr(pos, headerEnd - pos), size);
+                }
+                catch (const std::exception& err)
+                {
+                    error = err.what();
+                    break;
+                }
+                // the body is buffered whole, so its size is checked before any of it is kept
+                if (size > m_maxRequestSize)
+                {
+                    error = "Request body of " + std::to_string(size) + " bytes is over the limit of "
+                        + std::to_string(m_maxRequestSize) + " bytes";
+                    break;
+                }
+
+                if (buffer.size() - headerEnd - 1 < size)
+                {
+                    break;
+                }
+
+                requests.push_back({ args, buffer.substr(headerEnd + 1, size) });
+                pos = headerEnd + 1 + size;
+            }
+            buffer.erase(0, pos);
+
+            for (auto& request: requests)
+            {
+                pushResponse(m_pool.Submit([this, request = std::move(request)] { return Process(request); }));
+            }
+
+            // the stream cannot be resynchronized after a broken header, so the connection is closed
+            if (error)
+            {
+                std::promise<std::string> response;
+                response.set_value(FormatResponse("ERROR", *error));
+                pushResponse(response.get_future());
+                isFailed = true;
+            }
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            isReadDone = true;
+        }
+        condition.notify_all();
+        writer.join();
+    }
+#endif
+
+    std::string m_socketPath;
+    ThreadPool m_pool;
+    MemoryResultCache m_cache;
+    uintmax_t m_maxRequestSize;
+    size_t m_maxConnections;
+    std::mutex m_connectionsMutex;
+    std::condition_variable m_connectionsCondition;
+    std::set<int> m_connectionFds;
+    bool m_isStopping = false;
+};
@@ -0,0 +1,233 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+struct CachedResult
+{
+    std::string csv;
+    std::optional<std::string> canonicalHash;
+};
+
+// On-disk cache of minimization results keyed by a content hash of the parsed automata.
+// Entries are published with an atomic rename, so parallel invocations never see a partially written file.
+// The first line of an entry is the canonical hash, empty if canonical form was not requested, the CSV follows
+class ResultCache
+{
+public:
+    ResultCache(std::filesystem::path directory, const uintmax_t maxSize)
+        : m_directory(std::move(directory)),
+        m_maxSize(maxSize)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+        if (error)
+        {
+            throw std::runtime_error("Could not create cache directory " + m_directory.string());
+        }
+    }
+
+    std::optional<CachedResult> Load(const std::string& key) const
+    {
+        const auto entryPath = GetEntryPath(key);
+
+        // an opened entry stays readable even if a parallel eviction removes it
+        std::ifstream entry(entryPath, std::ios::binary);
+        std::string hashLine;
+        if (!entry.is_open() || !std::getline(entry, hashLine))
+        {
+            return std::nullopt;
+        }
+
+        CachedResult result;
+        if (!hashLine.empty())
+        {
+            result.canonicalHash = hashLine;
+        }
+        std::ostringstream csv;
+        if (entry.peek() != std::ifstream::traits_type::eof())
+        {
+            csv << entry.rdbuf();
+        }
+        result.csv = csv.str();
+
+        std::error_code error;
+        std::filesystem::last_write_time(entryPath, std::filesystem::file_time_type::clock::now(), error);
+
+        return result;
+    }
+
+    // The result is the CSV already written to the output, so a cache miss serializes the automata once
+    void Store(const std::string& key, const CachedResult& result)
+    {
+        const auto tempPath = m_directory / (key + TEMP_SUFFIX + GetUniqueSuffix());
+
+        std::error_code error;
+        {
+            std::ofstream temp(tempPath, std::ios::binary);
+            if (!temp.is_open())
+            {
+                return;
+            }
+            temp << result.canonicalHash.value_or("") << '\n' << result.csv;
+            if (!temp.flush())
+            {
+                error = std::make_error_code(std::errc::io_error);
+            }
+        }
+
+        if (!error)
+        {
+            std::filesystem::rename(tempPath, GetEntryPath(key), error);
+        }
+        if (error)
+        {
+            std::filesystem::remove(tempPath, error);
+            return;
+        }
+
+        Evict();
+    }
+
+private:
+    static constexpr auto ENTRY_EXTENSION = ".csv";
+    static constexpr auto TEMP_SUFFIX = ".tmp.";
+
+    [[nodiscard]] std::filesystem::path GetEntryPath(const std::string& key) const
+    {
+        return m_directory / (key + ENTRY_EXTENSION);
+    }
+
+    static std::string GetUniqueSuffix()
+    {
+        static std::atomic<unsigned> counter = 0;
+        std::random_device device;
+
+        return std::to_string(device()) + '.' + std::to_string(counter++);
+    }
+
+    // Removes least recently used entries until the cache fits into m_maxSize.
+    // Every filesystem error is ignored: another process may be evicting the same entries
+    void Evict() const
+    {
+        struct Entry
+        {
+            std::filesystem::path path;
+            std::filesystem::file_time_type lastUse;
+            uintmax_t size;
+        };
+
+        std::vector<Entry> entries;
+        uintmax_t totalSize = 0;
+
+        std::error_code error;
+        for (std::filesystem::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error))
+        {
+            if (it->path().extension() != ENTRY_EXTENSION)
+            {
+                continue;
+            }
+
+            std::error_code entryError;
+            auto size = it->file_size(entryError);
+            auto lastUse = it->last_write_time(entryError);
+            if (!entryError)
+            {
+                entries.push_back({ it->path(), lastUse, size });
+                totalSize += size;
+            }
+        }
+
+        if (totalSize <= m_maxSize)
+        {
+            return;
+        }
+
+        std::ranges::sort(entries, {}, &Entry::lastUse);
+        for (auto& entry: entries)
+        {
+            if (totalSize <= m_maxSize)
+            {
+                break;
+            }
+
+            std::filesystem::remove(entry.path, error);
+            totalSize -= entry.size;
+        }
+    }
+
+    std::filesystem::path m_directory;
+    uintmax_t m_maxSize;
+};
+
+// In-memory LRU cache of minimization results shared by the requests of a long-running server
+class MemoryResultCache
+{
+public:
+    using Result = CachedResult;
+
+    explicit MemoryResultCache(const uintmax_t maxSize)
+        : m_maxSize(maxSize)
+    {}
+
+    std::optional<Result> Load(const std::string& key)
+    {
+        std::lock_guard lock(m_mutex);
+
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
+        {
+            return std::nullopt;
+        }
+        m_lastUsed.splice(m_lastUsed.begin(), m_lastUsed, it->second);
+
+        return it->second->second;
+    }
+
+    void Store(const std::string& key, Result result)
+    {
+        const uintmax_t size = key.size() + result.csv.size();
+        if (size > m_maxSize)
+        {
+            return;
+        }
+
+        std::lock_guard lock(m_mutex);
+        if (m_entries.contains(key))
+        {
+            return;
+        }
+
+        m_lastUsed.emplace_front(key, std::move(result));
+        m_entries.emplace(key, m_lastUsed.begin());
+        m_size += size;
+
+        while (m_size > m_maxSize)
+        {
+            auto& [lastKey, lastResult] = m_lastUsed.back();
+            m_size -= lastKey.size() + lastResult.csv.size();
+            m_entries.erase(lastKey);
+            m_lastUsed.pop_back();
+        }
+    }
+
+private:
+    using Entry = std::pair<std::string, Result>;
+
+    std::mutex m_mutex;
+    std::list<Entry> m_lastUsed;
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_entries;
+    uintmax_t m_size = 0;
+    uintmax_t m_maxSize;
+};
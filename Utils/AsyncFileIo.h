@@ -0,0 +1,567 @@
+#pragma once
+#ifndef ASYNC_FILE_IO_H
+#define ASYNC_FILE_IO_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef MMM_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "ThreadPool.h"
+
+// Whole-file reads and writes with many of them in flight at once. Callbacks run on the I/O threads,
+// so they must return quickly and must not start new operations themselves: hand the data to a worker.
+// The destructor waits for every started operation
+class IAsyncFileIo
+{
+public:
+    // error is null on success
+    using ReadCallback = std::function<void(std::string data, std::exception_ptr error)>;
+    using WriteCallback = std::function<void(std::exception_ptr error)>;
+
+    // files a batch keeps in flight by default
+    static constexpr unsigned QUEUE_DEPTH = 64;
+
+    virtual void Read(std::string path, ReadCallback done) = 0;
+
+    // Creates or truncates the file
+    virtual void Write(std::string path, std::string data, WriteCallback done) = 0;
+
+    [[nodiscard]] virtual std::string GetName() const = 0;
+
+    virtual ~IAsyncFileIo() = default;
+};
+
+// Blocking open, pread and pwrite on a thread per operation in flight
+class PreadFileIo final : public IAsyncFileIo
+{
+public:
+    explicit PreadFileIo(const unsigned queueDepth = QUEUE_DEPTH)
+        : m_threads(std::max(1u, queueDepth))
+    {}
+
+    void Read(std::string path, ReadCallback done) override
+    {
+        m_threads.Submit([path = std::move(path), done = std::move(done)] {
+            std::string data;
+            std::exception_ptr error;
+            try
+            {
+                data = ReadFile(path);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            done(std::move(data), error);
+        });
+    }
+
+    void Write(std::string path, std::string data, WriteCallback done) override
+    {
+        m_threads.Submit([path = std::move(path), data = std::move(data), done = std::move(done)] {
+            std::exception_ptr error;
+            try
+            {
+                WriteFile(path, data);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            done(error);
+        });
+    }
+
+    [[nodiscard]] std::string GetName() const override
+    {
+        return "pread";
+    }
+
+private:
+#ifdef _WIN32
+    static std::string ReadFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Could not open file " + path);
+        }
+
+        std::ostringstream data;
+        data << file.rdbuf();
+
+        return data.str();
+    }
+
+    static void WriteFile(const std::string& path, const std::string& data)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open() || !file.write(data.data(), static_cast<std::streamsize>(data.size())) || !file.flush())
+        {
+            throw std::runtime_error("Could not write file " + path);
+        }
+    }
+#else
+    // Closes the descriptor when the operation leaves by an exception
+    class FileDescriptor
+    {
+    public:
+        explicit FileDescriptor(const int fd)
+            : m_fd(fd)
+        {}
+
+        FileDescriptor(const FileDescriptor&) = delete;
+        FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+        ~FileDescriptor()
+        {
+            if (m_fd >= 0)
+            {
+                close(m_fd);
+            }
+        }
+
+        [[nodiscard]] int Get() const
+        {
+            return m_fd;
+        }
+
+        // Returns false if the final close reports an error, as a deferred write error
+        bool Close()
+        {
+            const int fd = std::exchange(m_fd, -1);
+            return close(fd) == 0;
+        }
+
+    private:
+        int m_fd;
+    };
+
+    static std::string ReadFile(const std::string& path)
+    {
+        FileDescriptor fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+        if (fd.Get() < 0)
+        {
+            throw std::runtime_error("Could not open file " + path);
+        }
+
+        // regular files are read in one buffer of their size, anything else grows its buffer until the end
+        struct stat info {};
+        const bool isRegular = fstat(fd.Get(), &info) == 0 && S_ISREG(info.st_mode);
+        std::string data(isRegular ? static_cast<size_t>(info.st_size) : READ_CHUNK_SIZE, '\0');
+
+        size_t offset = 0;
+        while (!isRegular || offset < data.size())
+        {
+            if (offset == data.size())
+            {
+                data.resize(data.size() * 2);
+            }
+
+            // pipes have no offsets
+            const auto count = isRegular
+                ? pread(fd.Get(), data.data() + offset, data.size() - offset, static_cast<off_t>(offset))
+                : read(fd.Get(), data.data() + offset, data.size() - offset);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count < 0)
+            {
+                throw std::runtime_error("Could not read file " + path);
+            }
+            if (count == 0)
+            {
+                break;
+            }
+            offset += static_cast<size_t>(count);
+        }
+        data.resize(offset);
+
+        return data;
+    }
+
+    static void WriteFile(const std::string& path, const std::string& data)
+    {
+        FileDescriptor fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+        if (fd.Get() < 0)
+        {
+            throw std::runtime_error("Could not open file " + path + " for writing");
+        }
+
+        for (size_t offset = 0; offset < data.size();)
+        {
+            const auto count = pwrite(fd.Get(), data.data() + offset, data.size() - offset, static_cast<off_t>(offset));
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                throw std::runtime_error("Could not write file " + path);
+            }
+            offset += static_cast<size_t>(count);
+        }
+
+        if (!fd.Close())
+        {
+            throw std::runtime_error("Could not write file " + path);
+        }
+    }
+#endif
+
+    static constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+
+    ThreadPool m_threads;
+};
+
+#ifdef MMM_HAVE_LIBURING
+// One ring for every file: a file is opened, read or written and closed by a chain of submissions,
+// each completion submits the next step. A single reaper thread handles completions, the submissions
+// of new files come from any thread. Every file in flight holds one submission at a time,
+// so limiting the files to the ring size keeps the completion queue from overflowing
+class UringFileIo final : public IAsyncFileIo
+{
+public:
+    // Throws if the kernel has no io_uring or lacks one of the operations, callers fall back to pread
+    explicit UringFileIo(const unsigned queueDepth = QUEUE_DEPTH)
+        : m_slotsCount(std::max(1u, queueDepth))
+    {
+        if (const int error = io_uring_queue_init(m_slotsCount, &m_ring, 0); error < 0)
+        {
+            throw std::runtime_error("Could not create io_uring");
+        }
+
+        io_uring_probe* probe = io_uring_get_probe_ring(&m_ring);
+        const bool isSupported = probe
+            && io_uring_opcode_supported(probe, IORING_OP_OPENAT)
+            && io_uring_opcode_supported(probe, IORING_OP_READ)
+            && io_uring_opcode_supported(probe, IORING_OP_WRITE)
+            && io_uring_opcode_supported(probe, IORING_OP_CLOSE);
+        if (probe)
+        {
+            io_uring_free_probe(probe);
+        }
+        if (!isSupported)
+        {
+            io_uring_queue_exit(&m_ring);
+            throw std::runtime_error("io_uring does not support file operations");
+        }
+
+        m_reaper = std::thread([this] { Reap(); });
+    }
+
+    UringFileIo(const UringFileIo&) = delete;
+    UringFileIo& operator=(const UringFileIo&) = delete;
+
+    ~UringFileIo() override
+    {
+        {
+            // a no-op without an operation stops the reaper once every file is done
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_usedSlotsCount == 0; });
+            io_uring_sqe* sqe = GetSqe();
+            if (!sqe)
+            {
+                // the reaper could never be stopped
+                std::terminate();
+            }
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe, nullptr);
+            io_uring_submit(&m_ring);
+        }
+        m_reaper.join();
+        io_uring_queue_exit(&m_ring);
+    }
+
+    void Read(std::string path, ReadCallback done) override
+    {
+        auto operation = std::make_unique<Operation>();
+        operation->path = std::move(path);
+        operation->onRead = std::move(done);
+        Start(std::move(operation));
+    }
+
+    void Write(std::string path, std::string data, WriteCallback done) override
+    {
+        auto operation = std::make_unique<Operation>();
+        operation->isWrite = true;
+        operation->path = std::move(path);
+        operation->data = std::move(data);
+        operation->onWritten = std::move(done);
+        Start(std::move(operation));
+    }
+
+    [[nodiscard]] std::string GetName() const override
+    {
+        return "io_uring";
+    }
+
+private:
+    static constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+    // a single read or write submission is limited to 32-bit sizes
+    static constexpr size_t MAX_TRANSFER_SIZE = 1u << 30;
+    static constexpr int SUBMIT_ATTEMPTS = 4;
+
+    enum class Stage
+    {
+        Open,
+        Transfer,
+        Close
+    };
+
+    struct Operation
+    {
+        Stage stage = Stage::Open;
+        bool isWrite = false;
+        // regular files are read in one buffer of their size, anything else grows its buffer until the end
+        bool isRegular = false;
+        std::string path;
+        std::string data;
+        size_t offset = 0;
+        int fd = -1;
+        std::exception_ptr error;
+        ReadCallback onRead;
+        WriteCallback onWritten;
+    };
+
+    void Start(std::unique_ptr<Operation> operation)
+    {
+        std::unique_lock lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_usedSlotsCount < m_slotsCount; });
+        ++m_usedSlotsCount;
+
+        Operation* started = operation.release();
+        io_uring_sqe* sqe = GetSqe();
+        if (!sqe)
+        {
+            lock.unlock();
+            Fail(started);
+            return;
+        }
+        io_uring_prep_openat(sqe, AT_FDCWD, started->path.c_str(),
+            started->isWrite ? O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC : O_RDONLY | O_CLOEXEC, 0666);
+        io_uring_sqe_set_data(sqe, started);
+        io_uring_submit(&m_ring);
+    }
+
+    // An entry may be taken until the queued ones are submitted, so a full queue is submitted and tried again.
+    // Returns nullptr if it stays full. Called under m_mutex
+    io_uring_sqe* GetSqe()
+    {
+        for (int attempt = 0; attempt < SUBMIT_ATTEMPTS; ++attempt)
+        {
+            if (io_uring_sqe* sqe = io_uring_get_sqe(&m_ring))
+            {
+                return sqe;
+            }
+            io_uring_submit(&m_ring);
+        }
+
+        return nullptr;
+    }
+
+    // Ends an operation whose next step could not be submitted, an open file is closed here
+    void Fail(Operation* operation)
+    {
+        if (operation->fd >= 0)
+        {
+            close(operation->fd);
+        }
+        if (!operation->error)
+        {
+            operation->error = std::make_exception_ptr(std::runtime_error("Could not submit I/O for file "
+                + operation->path));
+        }
+        Finish(operation);
+    }
+
+    // Submits the next step of an operation in flight, its slot guarantees a free submission entry
+    void Submit(Operation* operation)
+    {
+        std::unique_lock lock(m_mutex);
+        io_uring_sqe* sqe = GetSqe();
+        if (!sqe)
+        {
+            lock.unlock();
+            Fail(operation);
+            return;
+        }
+        if (operation->stage == Stage::Close)
+        {
+            io_uring_prep_close(sqe, operation->fd);
+        }
+        else
+        {
+            const auto size = static_cast<unsigned>(
+                std::min(operation->data.size() - operation->offset, MAX_TRANSFER_SIZE));
+            if (operation->isWrite)
+            {
+                io_uring_prep_write(sqe, operation->fd, operation->data.data() + operation->offset, size,
+                    operation->offset);
+            }
+            else
+            {
+                // offset -1 reads from the current position, pipes have no offsets
+                io_uring_prep_read(sqe, operation->fd, operation->data.data() + operation->offset, size,
+                    operation->isRegular ? operation->offset : static_cast<__u64>(-1));
+            }
+        }
+        io_uring_sqe_set_data(sqe, operation);
+        io_uring_submit(&m_ring);
+    }
+
+    void Reap()
+    {
+        while (true)
+        {
+            io_uring_cqe* cqe = nullptr;
+            if (const int error = io_uring_wait_cqe(&m_ring, &cqe); error < 0)
+            {
+                if (error == -EINTR)
+                {
+                    continue;
+                }
+                // the ring is unusable, pending operations can never complete
+                std::terminate();
+            }
+
+            auto* operation = static_cast<Operation*>(io_uring_cqe_get_data(cqe));
+            const int result = cqe->res;
+            io_uring_cqe_seen(&m_ring, cqe);
+            if (!operation)
+            {
+                return;
+            }
+
+            Advance(operation, result);
+        }
+    }
+
+    void Advance(Operation* operation, const int result)
+    {
+        switch (operation->stage)
+        {
+        case Stage::Open:
+            if (result < 0)
+            {
+                operation->error = std::make_exception_ptr(std::runtime_error("Could not open file "
+                    + operation->path + (operation->isWrite ? " for writing" : "")));
+                Finish(operation);
+                return;
+            }
+            operation->fd = result;
+            operation->stage = Stage::Transfer;
+            if (!operation->isWrite)
+            {
+                struct stat info {};
+                operation->isRegular = fstat(operation->fd, &info) == 0 && S_ISREG(info.st_mode);
+                operation->data.resize(operation->isRegular ? static_cast<size_t>(info.st_size) : READ_CHUNK_SIZE);
+            }
+            break;
+        case Stage::Transfer:
+            if (result == -EINTR || result == -EAGAIN)
+            {
+                break;
+            }
+            if (result < 0 || (result == 0 && operation->isWrite))
+            {
+                operation->error = std::make_exception_ptr(std::runtime_error(
+                    (operation->isWrite ? "Could not write file " : "Could not read file ") + operation->path));
+                operation->stage = Stage::Close;
+                break;
+            }
+            if (result == 0)
+            {
+                operation->data.resize(operation->offset);
+                operation->stage = Stage::Close;
+                break;
+            }
+            operation->offset += static_cast<size_t>(result);
+            if (operation->offset == operation->data.size() && !operation->isWrite && !operation->isRegular)
+            {
+                operation->data.resize(operation->data.size() * 2);
+            }
+            break;
+        case Stage::Close:
+            if (result < 0 && operation->isWrite && !operation->error)
+            {
+                operation->error = std::make_exception_ptr(std::runtime_error("Could not write file " + operation->path));
+            }
+            Finish(operation);
+            return;
+        }
+
+        if (operation->stage == Stage::Transfer && operation->offset == operation->data.size())
+        {
+            operation->stage = Stage::Close;
+        }
+        Submit(operation);
+    }
+
+    void Finish(Operation* finished)
+    {
+        std::unique_ptr<Operation> operation(finished);
+        if (operation->isWrite)
+        {
+            operation->onWritten(operation->error);
+        }
+        else
+        {
+            operation->onRead(operation->error ? std::string() : std::move(operation->data), operation->error);
+        }
+        operation.reset();
+
+        {
+            std::lock_guard lock(m_mutex);
+            --m_usedSlotsCount;
+        }
+        m_condition.notify_all();
+    }
+
+    io_uring m_ring {};
+    unsigned m_slotsCount;
+    unsigned m_usedSlotsCount = 0;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::thread m_reaper;
+};
+#endif
+
+// io_uring when the build has liburing and the kernel allows it, the pread threads otherwise
+inline std::unique_ptr<IAsyncFileIo> CreateAsyncFileIo(const unsigned queueDepth = IAsyncFileIo::QUEUE_DEPTH)
+{
+#ifdef MMM_HAVE_LIBURING
+    try
+    {
+        return std::make_unique<UringFileIo>(queueDepth);
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+#endif
+    return std::make_unique<PreadFileIo>(queueDepth);
+}
+
+#endif
@@ -0,0 +1,233 @@
+#pragma once
+#ifndef CHUNKED_IO_H
+#define CHUNKED_IO_H
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+class IByteSource
+{
+public:
+    // Returns 0 only at the end of data, may return less than size while data is still arriving
+    virtual size_t Read(char* data, size_t size) = 0;
+
+    virtual ~IByteSource() = default;
+};
+
+class IByteSink
+{
+public:
+    virtual void Write(const char* data, size_t size) = 0;
+
+    virtual void Flush() {}
+
+    // Writes whatever trailer the format needs, no writes may follow
+    virtual void Close()
+    {
+        Flush();
+    }
+
+    virtual ~IByteSink() = default;
+};
+
+class StreamByteSource final : public IByteSource
+{
+public:
+    explicit StreamByteSource(std::istream& input)
+        : m_input(input)
+    {}
+
+    size_t Read(char* data, const size_t size) override
+    {
+        return static_cast<size_t>(m_input.rdbuf()->sgetn(data, static_cast<std::streamsize>(size)));
+    }
+
+private:
+    std::istream& m_input;
+};
+
+// Data already in memory, as a whole file read by the batch ingest
+class MemoryByteSource final : public IByteSource
+{
+public:
+    explicit MemoryByteSource(const std::string_view data)
+        : m_data(data)
+    {}
+
+    size_t Read(char* data, const size_t size) override
+    {
+        const size_t count = std::min(size, m_data.size());
+        m_data.copy(data, count);
+        m_data.remove_prefix(count);
+
+        return count;
+    }
+
+private:
+    std::string_view m_data;
+};
+
+#ifndef _WIN32
+// Reads whatever a pipe already has instead of waiting for a whole chunk
+class FileDescriptorByteSource final : public IByteSource
+{
+public:
+    explicit FileDescriptorByteSource(const int fd)
+        : m_fd(fd)
+    {}
+
+    size_t Read(char* data, const size_t size) override
+    {
+        while (true)
+        {
+            const auto count = read(m_fd, data, size);
+            if (count >= 0)
+            {
+                return static_cast<size_t>(count);
+            }
+            if (errno != EINTR)
+            {
+                throw std::runtime_error("Could not read input");
+            }
+        }
+    }
+
+private:
+    int m_fd;
+};
+#endif
+
+class StreamByteSink final : public IByteSink
+{
+public:
+    explicit StreamByteSink(std::ostream& output)
+        : m_output(output)
+    {}
+
+    void Write(const char* data, const size_t size) override
+    {
+        if (!m_output.write(data, static_cast<std::streamsize>(size)))
+        {
+            throw std::runtime_error("Could not write output");
+        }
+    }
+
+    void Flush() override
+    {
+        if (!m_output.flush())
+        {
+            throw std::runtime_error("Could not write output");
+        }
+    }
+
+private:
+    std::ostream& m_output;
+};
+
+// Input buffer refilled in large chunks, so rows are parsed as soon as their chunk arrives
+class ChunkedInputBuffer final : public std::streambuf
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+    explicit ChunkedInputBuffer(IByteSource& source, const size_t chunkSize = CHUNK_SIZE)
+        : m_source(source),
+        m_buffer(chunkSize)
+    {}
+
+protected:
+    int_type underflow() override
+    {
+        if (gptr() < egptr())
+        {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        const size_t count = m_source.Read(m_buffer.data(), m_buffer.size());
+        if (count == 0)
+        {
+            return traits_type::eof();
+        }
+        setg(m_buffer.data(), m_buffer.data(), m_buffer.data() + count);
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    IByteSource& m_source;
+    std::vector<char> m_buffer;
+};
+
+// Output buffer that hands data to the sink in large blocks only
+class ChunkedOutputBuffer final : public std::streambuf
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+    explicit ChunkedOutputBuffer(IByteSink& sink, const size_t chunkSize = CHUNK_SIZE)
+        : m_sink(sink),
+        m_buffer(chunkSize)
+    {
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+    }
+
+    ChunkedOutputBuffer(const ChunkedOutputBuffer&) = delete;
+    ChunkedOutputBuffer& operator=(const ChunkedOutputBuffer&) = delete;
+
+    ~ChunkedOutputBuffer() override
+    {
+        try
+        {
+            WriteBuffer();
+        }
+        catch (...)
+        {
+        }
+    }
+
+protected:
+    int_type overflow(const int_type ch) override
+    {
+        WriteBuffer();
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override
+    {
+        WriteBuffer();
+        m_sink.Flush();
+
+        return 0;
+    }
+
+private:
+    void WriteBuffer()
+    {
+        if (pptr() > pbase())
+        {
+            m_sink.Write(pbase(), pptr() - pbase());
+            setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+        }
+    }
+
+    IByteSink& m_sink;
+    std::vector<char> m_buffer;
+};
+
+#endif
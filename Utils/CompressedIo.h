@@ -0,0 +1,465 @@
+#pragma once
+#ifndef COMPRESSED_IO_H
+#define COMPRESSED_IO_H
+
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef MMM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef MMM_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "ChunkedIo.h"
+
+enum class Compression
+{
+    None,
+    Gzip,
+    Zstd
+};
+
+inline Compression DetectCompression(const std::string& header)
+{
+    if (header.size() >= 2 && header[0] == '\x1f' && header[1] == '\x8b')
+    {
+        return Compression::Gzip;
+    }
+    if (header.size() >= 4 && header.compare(0, 4, "\x28\xb5\x2f\xfd") == 0)
+    {
+        return Compression::Zstd;
+    }
+
+    return Compression::None;
+}
+
+inline Compression GetCompressionByExtension(const std::string& filename)
+{
+    if (filename.ends_with(".gz"))
+    {
+        return Compression::Gzip;
+    }
+    if (filename.ends_with(".zst"))
+    {
+        return Compression::Zstd;
+    }
+
+    return Compression::None;
+}
+
+// Gives back the bytes read ahead for format detection before the rest of the source
+class PrefixedByteSource final : public IByteSource
+{
+public:
+    PrefixedByteSource(std::string prefix, IByteSource& source)
+        : m_prefix(std::move(prefix)),
+        m_source(source)
+    {}
+
+    size_t Read(char* data, const size_t size) override
+    {
+        if (m_prefixPos < m_prefix.size())
+        {
+            const size_t count = m_prefix.copy(data, size, m_prefixPos);
+            m_prefixPos += count;
+            return count;
+        }
+
+        return m_source.Read(data, size);
+    }
+
+private:
+    std::string m_prefix;
+    size_t m_prefixPos = 0;
+    IByteSource& m_source;
+};
+
+// Decompresses on its own thread and hands decompressed chunks over a bounded queue,
+// so reading and inflating the file overlap with parsing of the rows
+class ThreadedDecompressionSource final : public IByteSource
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+    static constexpr size_t QUEUE_CAPACITY = 4;
+
+    ThreadedDecompressionSource(std::unique_ptr<IByteSource> compressed, const Compression compression)
+        : m_compressed(std::move(compressed))
+    {
+        m_thread = std::thread([this, compression] {
+            try
+            {
+                compression == Compression::Gzip ? InflateGzip() : DecompressZstd();
+            }
+            catch (...)
+            {
+                std::lock_guard lock(m_mutex);
+                m_error = std::current_exception();
+            }
+            Push({});
+        });
+    }
+
+    ThreadedDecompressionSource(const ThreadedDecompressionSource&) = delete;
+    ThreadedDecompressionSource& operator=(const ThreadedDecompressionSource&) = delete;
+
+    ~ThreadedDecompressionSource() override
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_isStopped = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+    }
+
+    size_t Read(char* data, const size_t size) override
+    {
+        if (m_chunkPos == m_chunk.size())
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return !m_chunks.empty(); });
+
+            m_chunk = std::move(m_chunks.front());
+            m_chunks.pop();
+            m_chunkPos = 0;
+            m_condition.notify_all();
+
+            if (m_chunk.empty())
+            {
+                // keep the end marker for further reads
+                m_chunks.emplace();
+                if (m_error)
+                {
+                    std::rethrow_exception(m_error);
+                }
+                return 0;
+            }
+        }
+
+        const size_t count = std::min(size, m_chunk.size() - m_chunkPos);
+        std::memcpy(data, m_chunk.data() + m_chunkPos, count);
+        m_chunkPos += count;
+
+        return count;
+    }
+
+private:
+    // an empty chunk marks the end of data, returns false if the reader is gone
+    bool Push(std::vector<char> chunk)
+    {
+        std::unique_lock lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_isStopped || m_chunks.size() < QUEUE_CAPACITY; });
+        if (m_isStopped)
+        {
+            return false;
+        }
+        m_chunks.push(std::move(chunk));
+        m_condition.notify_all();
+
+        return true;
+    }
+
+    void InflateGzip()
+    {
+#ifdef MMM_HAVE_ZLIB
+        z_stream stream {};
+        // 32 lets zlib detect the gzip header
+        if (inflateInit2(&stream, 15 + 32) != Z_OK)
+        {
+            throw std::runtime_error("Could not initialize gzip decompression");
+        }
+        std::unique_ptr<z_stream, decltype(&inflateEnd)> streamGuard(&stream, inflateEnd);
+
+        std::vector<char> input(CHUNK_SIZE);
+        std::vector<char> output(CHUNK_SIZE);
+        bool isStreamEnd = false;
+
+        while (size_t inputSize = m_compressed->Read(input.data(), input.size()))
+        {
+            stream.next_in = reinterpret_cast<Bytef*>(input.data());
+            stream.avail_in = static_cast<uInt>(inputSize);
+
+            while (stream.avail_in > 0)
+            {
+                // concatenated gzip members are decoded one after another
+                if (isStreamEnd)
+                {
+                    inflateReset(&stream);
+                    isStreamEnd = false;
+                }
+
+                stream.next_out = reinterpret_cast<Bytef*>(output.data());
+                stream.avail_out = static_cast<uInt>(output.size());
+
+                const int result = inflate(&stream, Z_NO_FLUSH);
+                if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+                {
+                    throw std::runtime_error("Invalid gzip data");
+                }
+                isStreamEnd = result == Z_STREAM_END;
+
+                const size_t outputSize = output.size() - stream.avail_out;
+                if (outputSize > 0 && !Push(std::vector<char>(output.begin(), output.begin() + outputSize)))
+                {
+                    return;
+                }
+            }
+        }
+
+        if (!isStreamEnd)
+        {
+            throw std::runtime_error("Truncated gzip data");
+        }
+#else
+        throw std::runtime_error("gzip support is not compiled in");
+#endif
+    }
+
+    void DecompressZstd()
+    {
+#ifdef MMM_HAVE_ZSTD
+        std::unique_ptr<ZSTD_DStream, decltype(&ZSTD_freeDStream)> stream(ZSTD_createDStream(), ZSTD_freeDStream);
+        if (!stream)
+        {
+            throw std::runtime_error("Could not initialize zstd decompression");
+        }
+
+        std::vector<char> input(ZSTD_DStreamInSize());
+        std::vector<char> output(ZSTD_DStreamOutSize());
+        size_t lastResult = 0;
+
+        while (size_t inputSize = m_compressed->Read(input.data(), input.size()))
+        {
+            ZSTD_inBuffer inBuffer = { input.data(), inputSize, 0 };
+            while (inBuffer.pos < inBuffer.size)
+            {
+                ZSTD_outBuffer outBuffer = { output.data(), output.size(), 0 };
+                lastResult = ZSTD_decompressStream(stream.get(), &outBuffer, &inBuffer);
+                if (ZSTD_isError(lastResult))
+                {
+                    throw std::runtime_error("Invalid zstd data");
+                }
+
+                if (outBuffer.pos > 0 && !Push(std::vector<char>(output.begin(), output.begin() + outBuffer.pos)))
+                {
+                    return;
+                }
+            }
+        }
+
+        if (lastResult != 0)
+        {
+            throw std::runtime_error("Truncated zstd data");
+        }
+#else
+        throw std::runtime_error("zstd support is not compiled in");
+#endif
+    }
+
+    std::unique_ptr<IByteSource> m_compressed;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::queue<std::vector<char>> m_chunks;
+    std::exception_ptr m_error;
+    bool m_isStopped = false;
+
+    std::vector<char> m_chunk;
+    size_t m_chunkPos = 0;
+};
+
+// Detects gzip and zstd input by its magic bytes
+inline std::unique_ptr<IByteSource> OpenDecompressedSource(IByteSource& source)
+{
+    constexpr size_t MAGIC_SIZE = 4;
+
+    std::string header(MAGIC_SIZE, '\0');
+    size_t headerSize = 0;
+    while (headerSize < MAGIC_SIZE)
+    {
+        const size_t count = source.Read(header.data() + headerSize, MAGIC_SIZE - headerSize);
+        if (count == 0)
+        {
+            break;
+        }
+        headerSize += count;
+    }
+    header.resize(headerSize);
+
+    const auto compression = DetectCompression(header);
+    auto prefixed = std::make_unique<PrefixedByteSource>(std::move(header), source);
+    if (compression == Compression::None)
+    {
+        return prefixed;
+    }
+
+    return std::make_unique<ThreadedDecompressionSource>(std::move(prefixed), compression);
+}
+
+#ifdef MMM_HAVE_ZLIB
+class GzipByteSink final : public IByteSink
+{
+public:
+    explicit GzipByteSink(IByteSink& sink)
+        : m_sink(sink),
+        m_output(ChunkedOutputBuffer::CHUNK_SIZE)
+    {
+        // 16 makes zlib write a gzip header
+        if (deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            throw std::runtime_error("Could not initialize gzip compression");
+        }
+    }
+
+    ~GzipByteSink() override
+    {
+        deflateEnd(&m_stream);
+    }
+
+    void Write(const char* data, const size_t size) override
+    {
+        m_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_stream.avail_in = static_cast<uInt>(size);
+        Deflate(Z_NO_FLUSH);
+    }
+
+    void Close() override
+    {
+        Deflate(Z_FINISH);
+        m_sink.Close();
+    }
+
+private:
+    void Deflate(const int flush)
+    {
+        do
+        {
+            m_stream.next_out = reinterpret_cast<Bytef*>(m_output.data());
+            m_stream.avail_out = static_cast<uInt>(m_output.size());
+            if (deflate(&m_stream, flush) == Z_STREAM_ERROR)
+            {
+                throw std::runtime_error("gzip compression failed");
+            }
+            m_sink.Write(m_output.data(), m_output.size() - m_stream.avail_out);
+        } while (m_stream.avail_out == 0);
+    }
+
+    IByteSink& m_sink;
+    z_stream m_stream {};
+    std::vector<char> m_output;
+};
+#endif
+
+#ifdef MMM_HAVE_ZSTD
+class ZstdByteSink final : public IByteSink
+{
+public:
+    explicit ZstdByteSink(IByteSink& sink)
+        : m_sink(sink),
+        m_stream(ZSTD_createCStream(), ZSTD_freeCStream),
+        m_output(ZSTD_CStreamOutSize())
+    {
+        if (!m_stream || ZSTD_isError(ZSTD_initCStream(m_stream.get(), ZSTD_CLEVEL_DEFAULT)))
+        {
+            throw std::runtime_error("Could not initialize zstd compression");
+        }
+    }
+
+    void Write(const char* data, const size_t size) override
+    {
+        ZSTD_inBuffer input = { data, size, 0 };
+        while (input.pos < input.size)
+        {
+            ZSTD_outBuffer output = { m_output.data(), m_output.size(), 0 };
+            if (ZSTD_isError(ZSTD_compressStream(m_stream.get(), &output, &input)))
+            {
+                throw std::runtime_error("zstd compression failed");
+            }
+            m_sink.Write(m_output.data(), output.pos);
+        }
+    }
+
+    void Close() override
+    {
+        size_t remaining = 0;
+        do
+        {
+            ZSTD_outBuffer output = { m_output.data(), m_output.size(), 0 };
+            remaining = ZSTD_endStream(m_stream.get(), &output);
+            if (ZSTD_isError(remaining))
+            {
+                throw std::runtime_error("zstd compression failed");
+            }
+            m_sink.Write(m_output.data(), output.pos);
+        } while (remaining > 0);
+        m_sink.Close();
+    }
+
+private:
+    IByteSink& m_sink;
+    std::unique_ptr<ZSTD_CStream, decltype(&ZSTD_freeCStream)> m_stream;
+    std::vector<char> m_output;
+};
+#endif
+
+// the sink is unused when neither compression library is compiled in
+inline std::unique_ptr<IByteSink> CreateCompressingSink([[maybe_unused]] IByteSink& sink, const Compression compression)
+{
+    switch (compression)
+    {
+        case Compression::Gzip:
+#ifdef MMM_HAVE_ZLIB
+            return std::make_unique<GzipByteSink>(sink);
+#else
+            throw std::runtime_error("gzip support is not compiled in");
+#endif
+        case Compression::Zstd:
+#ifdef MMM_HAVE_ZSTD
+            return std::make_unique<ZstdByteSink>(sink);
+#else
+            throw std::runtime_error("zstd support is not compiled in");
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+// Writes through a large block buffer and, for .gz and .zst file names, a compressor
+inline void WriteCompressed(std::ostream& file, const Compression compression,
+    const std::function<void(std::ostream&)>& write)
+{
+    StreamByteSink fileSink(file);
+    auto compressingSink = CreateCompressingSink(fileSink, compression);
+    IByteSink& sink = compressingSink ? *compressingSink : fileSink;
+
+    {
+        // a stream only sets badbit when its buffer throws, the mask rethrows the write error of the sink
+        ChunkedOutputBuffer buffer(sink);
+        std::ostream output(&buffer);
+        output.exceptions(std::ios::badbit);
+        write(output);
+        output.flush();
+    }
+    sink.Close();
+
+    // a file stream keeps the last bytes buffered, a full disk shows only when they are flushed
+    if (!file.flush())
+    {
+        throw std::runtime_error("Could not write output");
+    }
+}
+
+#endif
@@ -0,0 +1,203 @@
+#pragma once
+#ifndef SIMD_ROWS_H
+#define SIMD_ROWS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Operations on contiguous rows of uint32_t, as the signature rows of the refinement engines.
+// The AVX2 paths are chosen at compile time, there is no dispatch on the CPU at run time: they are built only
+// when __AVX2__ is defined, i.e. with -DMMM_MARCH=x86-64-v3 (or newer, or native on an AVX2 host) or -mavx2.
+// A default build uses the scalar paths, which give the same results
+namespace SimdRows
+{
+    // odd and below 2^32, so a 64-bit lane is multiplied by it with two 32-bit multiplies
+    constexpr uint64_t HASH_MULTIPLIER = 0x9e3779b1;
+
+    inline uint64_t Mix(uint64_t hash, const uint64_t value)
+    {
+        hash = (hash ^ value) * HASH_MULTIPLIER;
+        return hash ^ (hash >> 29);
+    }
+
+    // result[i] = values[indexes[i]]. Indexes must be below 2^31, the gather takes them as signed
+    inline void Gather(const uint32_t* values, const uint32_t* indexes, const size_t size, uint32_t* result)
+    {
+        size_t i = 0;
+#ifdef __AVX2__
+        for (; i + 8 <= size; i += 8)
+        {
+            const __m256i gatherIndexes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indexes + i));
+            const __m256i gathered = _mm256_i32gather_epi32(reinterpret_cast<const int*>(values), gatherIndexes, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), gathered);
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            result[i] = values[indexes[i]];
+        }
+    }
+
+    inline bool AreEqual(const uint32_t* first, const uint32_t* second, const size_t size)
+    {
+        size_t i = 0;
+#ifdef __AVX2__
+        for (; i + 8 <= size; i += 8)
+        {
+            const __m256i equal = _mm256_cmpeq_epi32(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + i)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(second + i)));
+            if (_mm256_movemask_epi8(equal) != -1)
+            {
+                return false;
+            }
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            if (first[i] != second[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // values[firstIndexes[i]] == values[secondIndexes[i]] for every i, without storing the gathered rows
+    inline bool AreGatheredEqual(const uint32_t* values, const uint32_t* firstIndexes, const uint32_t* secondIndexes,
+        const size_t size)
+    {
+        size_t i = 0;
+#ifdef __AVX2__
+        const auto* base = reinterpret_cast<const int*>(values);
+        for (; i + 8 <= size; i += 8)
+        {
+            const __m256i equal = _mm256_cmpeq_epi32(
+                _mm256_i32gather_epi32(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(firstIndexes + i)), 4),
+                _mm256_i32gather_epi32(base, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secondIndexes + i)), 4));
+            if (_mm256_movemask_epi8(equal) != -1)
+            {
+                return false;
+            }
+        }
+#endif
+        for (; i < size; ++i)
+        {
+            if (values[firstIndexes[i]] != values[secondIndexes[i]])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Blocks of eight values go to four 64-bit lanes, two values a lane. The lanes, then the tail
+    // two values at a time, are mixed into the result
+    inline uint64_t Hash(const uint32_t* row, const size_t size, const uint64_t seed = 0)
+    {
+        uint64_t hash = Mix(seed, size);
+        size_t i = 0;
+        if (size >= 8)
+        {
+            uint64_t lanes[4] = { hash, hash, hash, hash };
+#ifdef __AVX2__
+            __m256i accumulator = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+            const __m256i multiplier = _mm256_set1_epi64x(HASH_MULTIPLIER);
+            for (; i + 8 <= size; i += 8)
+            {
+                // lane j of the load is row[i + 2j] | row[i + 2j + 1] << 32
+                accumulator = _mm256_xor_si256(accumulator,
+                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i)));
+                const __m256i low = _mm256_mul_epu32(accumulator, multiplier);
+                const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(accumulator, 32), multiplier);
+                accumulator = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+                accumulator = _mm256_xor_si256(accumulator, _mm256_srli_epi64(accumulator, 29));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+#else
+            for (; i + 8 <= size; i += 8)
+            {
+                for (size_t lane = 0; lane < 4; ++lane)
+                {
+                    lanes[lane] = Mix(lanes[lane], uint64_t(row[i + 2 * lane]) | uint64_t(row[i + 2 * lane + 1]) << 32);
+                }
+            }
+#endif
+            for (auto lane: lanes)
+            {
+                hash = Mix(hash, lane);
+            }
+        }
+
+        for (; i + 2 <= size; i += 2)
+        {
+            hash = Mix(hash, uint64_t(row[i]) | uint64_t(row[i + 1]) << 32);
+        }
+        if (i < size)
+        {
+            hash = Mix(hash, row[i]);
+        }
+
+        return hash;
+    }
+
+    // Hash of the pairs keys[i] | values[indexes[i]] << 32 without storing the gathered values.
+    // Blocks of four pairs go to four 64-bit lanes, short rows are mixed pair by pair
+    inline uint64_t HashPairs(const uint32_t* keys, const uint32_t* values, const uint32_t* indexes,
+        const size_t size, const uint64_t seed = 0)
+    {
+        uint64_t hash = Mix(seed, size);
+        size_t i = 0;
+        if (size >= 8)
+        {
+            uint64_t lanes[4] = { hash, hash, hash, hash };
+#ifdef __AVX2__
+            const auto* base = reinterpret_cast<const int*>(values);
+            __m256i accumulator = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+            const __m256i multiplier = _mm256_set1_epi64x(HASH_MULTIPLIER);
+            for (; i + 4 <= size; i += 4)
+            {
+                const __m128i blockKeys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+                const __m128i blockValues = _mm_i32gather_epi32(base,
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(indexes + i)), 4);
+                const __m256i pairs = _mm256_set_m128i(
+                    _mm_unpackhi_epi32(blockKeys, blockValues), _mm_unpacklo_epi32(blockKeys, blockValues));
+
+                accumulator = _mm256_xor_si256(accumulator, pairs);
+                const __m256i low = _mm256_mul_epu32(accumulator, multiplier);
+                const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(accumulator, 32), multiplier);
+                accumulator = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+                accumulator = _mm256_xor_si256(accumulator, _mm256_srli_epi64(accumulator, 29));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+#else
+            for (; i + 4 <= size; i += 4)
+            {
+                for (size_t lane = 0; lane < 4; ++lane)
+                {
+                    lanes[lane] = Mix(lanes[lane], keys[i + lane] | uint64_t(values[indexes[i + lane]]) << 32);
+                }
+            }
+#endif
+            for (auto lane: lanes)
+            {
+                hash = Mix(hash, lane);
+            }
+        }
+
+        for (; i < size; ++i)
+        {
+            hash = Mix(hash, keys[i] | uint64_t(values[indexes[i]]) << 32);
+        }
+
+        return hash;
+    }
+}
+
+#endif
@@ -0,0 +1,99 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // threadsCount = 0 means one thread per hardware thread
+    explicit ThreadPool(unsigned threadsCount = 0)
+    {
+        if (threadsCount == 0)
+        {
+            threadsCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (unsigned i = 0; i < threadsCount; ++i)
+        {
+            m_threads.emplace_back([this] { Work(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_isStopped = true;
+        }
+        m_condition.notify_all();
+
+        for (auto& thread: m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    template <typename Task>
+    auto Submit(Task&& task) -> std::future<std::invoke_result_t<Task>>
+    {
+        auto packagedTask = std::make_shared<std::packaged_task<std::invoke_result_t<Task>()>>(
+            std::forward<Task>(task));
+        auto future = packagedTask->get_future();
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_tasks.emplace([packagedTask] { (*packagedTask)(); });
+        }
+        m_condition.notify_one();
+
+        return future;
+    }
+
+    [[nodiscard]] size_t GetThreadsCount() const
+    {
+        return m_threads.size();
+    }
+
+private:
+    void Work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_isStopped || !m_tasks.empty(); });
+                if (m_tasks.empty())
+                {
+                    return;
+                }
+
+                task = std::move(m_tasks.front());
+                m_tasks.pop();
+            }
+
+            task();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_isStopped = false;
+};
+
+#endif
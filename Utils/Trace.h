@@ -0,0 +1,273 @@
+#pragma once
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Chrome trace-event recording: phases are complete ("X") events, per-round data are instant events with
+// arguments, sizes over time are counters. Timestamps come from the monotonic clock, which perf uses with
+// --clock-id=monotonic, so the samples line up with the trace. Events are kept in memory until Write
+//
+// The MMM_TRACE_* macros compile to nothing unless MMM_ENABLE_TRACING is defined. Their arguments are
+// evaluated only while a trace is being recorded
+namespace Trace
+{
+    struct Event
+    {
+        std::string name;
+        char phase;
+        double timestamp;
+        double duration;
+        uint64_t threadId;
+        // JSON object body without braces
+        std::string args;
+    };
+
+    class Recorder
+    {
+    public:
+        static Recorder& Get()
+        {
+            static Recorder recorder;
+            return recorder;
+        }
+
+        void Start()
+        {
+            std::lock_guard lock(m_mutex);
+            m_events.clear();
+            m_isEnabled = true;
+        }
+
+        [[nodiscard]] bool IsEnabled() const
+        {
+            return m_isEnabled.load(std::memory_order_relaxed);
+        }
+
+        static double GetTimestamp()
+        {
+            const auto now = std::chrono::steady_clock::now().time_since_epoch();
+            return std::chrono::duration<double, std::micro>(now).count();
+        }
+
+        void Add(Event event)
+        {
+            std::lock_guard lock(m_mutex);
+            m_events.push_back(std::move(event));
+        }
+
+        // Stops recording and writes the events as a JSON object loadable by chrome://tracing and Perfetto
+        void Write(const std::string& filename)
+        {
+            std::lock_guard lock(m_mutex);
+            m_isEnabled = false;
+
+            std::ofstream file(filename);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Could not open the trace file " + filename);
+            }
+
+            file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"clock\":\"monotonic\"},\"traceEvents\":[";
+            for (size_t i = 0; i < m_events.size(); ++i)
+            {
+                const auto& event = m_events[i];
+                file << (i == 0 ? "\n" : ",\n")
+                    << "{\"name\":\"" << event.name << "\",\"cat\":\"minimization\",\"ph\":\"" << event.phase
+                    << "\",\"ts\":" << std::fixed << event.timestamp
+                    << ",\"pid\":" << GetProcessId() << ",\"tid\":" << event.threadId;
+                if (event.phase == 'X')
+                {
+                    file << ",\"dur\":" << event.duration;
+                }
+                if (event.phase == 'i')
+                {
+                    file << ",\"s\":\"t\"";
+                }
+                file << ",\"args\":{" << event.args << "}}";
+            }
+            file << "\n]}\n";
+            m_events.clear();
+        }
+
+        // the kernel thread id, as perf reports it
+        static uint64_t GetThreadId()
+        {
+#ifdef __linux__
+            return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+            return std::hash<std::thread::id>{}(std::this_thread::get_id());
+#endif
+        }
+
+    private:
+        static uint64_t GetProcessId()
+        {
+#ifdef __linux__
+            return static_cast<uint64_t>(getpid());
+#else
+            return 1;
+#endif
+        }
+
+        std::atomic<bool> m_isEnabled = false;
+        std::mutex m_mutex;
+        std::vector<Event> m_events;
+    };
+
+    inline bool IsEnabled()
+    {
+        return Recorder::Get().IsEnabled();
+    }
+
+    // Complete event from construction to destruction
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name)
+            : m_name(name),
+            m_isEnabled(IsEnabled()),
+            m_start(m_isEnabled ? Recorder::GetTimestamp() : 0)
+        {}
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope()
+        {
+            if (m_isEnabled)
+            {
+                Recorder::Get().Add({ m_name, 'X', m_start, Recorder::GetTimestamp() - m_start,
+                    Recorder::GetThreadId(), {} });
+            }
+        }
+
+    private:
+        const char* m_name;
+        bool m_isEnabled;
+        double m_start;
+    };
+
+    inline void Instant(const char* name, std::string args)
+    {
+        Recorder::Get().Add({ name, 'i', Recorder::GetTimestamp(), 0, Recorder::GetThreadId(), std::move(args) });
+    }
+
+    inline void Counter(const char* name, const uint64_t value)
+    {
+        Recorder::Get().Add({ name, 'C', Recorder::GetTimestamp(), 0, Recorder::GetThreadId(),
+            "\"value\":" + std::to_string(value) });
+    }
+
+    // Builds the args of an event: Args().Add("blocks", 10).Add("sizes", GetSizeHistogram(...)).Get()
+    class Args
+    {
+    public:
+        Args& Add(const char* key, const uint64_t value)
+        {
+            return AddRaw(key, std::to_string(value));
+        }
+
+        Args& AddRaw(const char* key, const std::string& json)
+        {
+            m_json += (m_json.empty() ? "\"" : ",\"") + std::string(key) + "\":" + json;
+            return *this;
+        }
+
+        [[nodiscard]] std::string Get() const
+        {
+            return m_json;
+        }
+
+    private:
+        std::string m_json;
+    };
+
+    // Numbers of blocks by size in power of two buckets, empty buckets left out: {"1":.., "2-3":.., "4-7":..}
+    template <typename Blocks>
+    std::string GetBlockSizeHistogram(const Blocks& blocks)
+    {
+        std::vector<uint64_t> sizes;
+        for (auto block: blocks)
+        {
+            if (block >= sizes.size())
+            {
+                sizes.resize(block + 1, 0);
+            }
+            ++sizes[block];
+        }
+
+        std::vector<uint64_t> buckets;
+        for (auto size: sizes)
+        {
+            if (size == 0)
+            {
+                continue;
+            }
+
+            size_t bucket = 0;
+            while ((uint64_t(2) << bucket) <= size)
+            {
+                ++bucket;
+            }
+            if (bucket >= buckets.size())
+            {
+                buckets.resize(bucket + 1, 0);
+            }
+            ++buckets[bucket];
+        }
+
+        std::ostringstream json;
+        json << '{';
+        for (size_t bucket = 0; bucket < buckets.size(); ++bucket)
+        {
+            if (buckets[bucket] == 0)
+            {
+                continue;
+            }
+
+            const uint64_t first = uint64_t(1) << bucket;
+            json << (json.tellp() == 1 ? "\"" : ",\"") << first;
+            if (bucket != 0)
+            {
+                json << '-' << (first * 2 - 1);
+            }
+            json << "\":" << buckets[bucket];
+        }
+        json << '}';
+
+        return json.str();
+    }
+}
+
+#ifdef MMM_ENABLE_TRACING
+#define MMM_TRACE_CONCAT_INNER(a, b) a##b
+#define MMM_TRACE_CONCAT(a, b) MMM_TRACE_CONCAT_INNER(a, b)
+#define MMM_TRACE_SCOPE(name) const Trace::Scope MMM_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define MMM_TRACE_INSTANT(name, args) \
+    do { if (Trace::IsEnabled()) { Trace::Instant(name, args); } } while (false)
+#define MMM_TRACE_COUNTER(name, value) \
+    do { if (Trace::IsEnabled()) { Trace::Counter(name, value); } } while (false)
+#else
+#define MMM_TRACE_SCOPE(name) do {} while (false)
+#define MMM_TRACE_INSTANT(name, args) do {} while (false)
+#define MMM_TRACE_COUNTER(name, value) do {} while (false)
+#endif
+
+#endif
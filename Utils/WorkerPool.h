@@ -0,0 +1,380 @@
+#pragma once
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Leaves trivially constructible elements uninitialized on resize, so the pages of a large array
+// are first written, and placed on a NUMA node, by the worker that fills its slice
+template <typename T>
+struct FirstTouchAllocator : std::allocator<T>
+{
+    template <typename U>
+    struct rebind
+    {
+        using other = FirstTouchAllocator<U>;
+    };
+
+    FirstTouchAllocator() = default;
+
+    template <typename U>
+    explicit FirstTouchAllocator(const FirstTouchAllocator<U>&) noexcept
+    {}
+
+    template <typename U>
+    void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>)
+    {
+        ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args)
+    {
+        ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
+using StateArray = std::vector<uint32_t, FirstTouchAllocator<uint32_t>>;
+
+// Fixed set of threads for the parallel phases of minimization. Work is given by ranges of states:
+// worker w always gets the w-th slice of the same range, so data it wrote in one phase stays
+// in its cache and on its memory node for the next one
+class WorkerPool
+{
+public:
+    enum class Affinity
+    {
+        // threads are left to the scheduler
+        None,
+        // threads fill the CPUs of one memory node before the next one
+        Compact,
+        // threads go round-robin over the memory nodes
+        Spread
+    };
+
+    // ranges smaller than this run on the calling thread, waking the workers costs more
+    static constexpr size_t MIN_PARALLEL_ITEMS = 16384;
+
+    static Affinity ParseAffinity(const std::string& affinity)
+    {
+        if (affinity == "none")
+        {
+            return Affinity::None;
+        }
+        if (affinity == "compact")
+        {
+            return Affinity::Compact;
+        }
+        if (affinity == "spread")
+        {
+            return Affinity::Spread;
+        }
+
+        throw std::invalid_argument("Invalid affinity " + affinity);
+    }
+
+    // threadsCount = 0 means one thread per hardware thread
+    explicit WorkerPool(unsigned threadsCount = 0, const Affinity affinity = Affinity::None)
+    {
+        if (threadsCount == 0)
+        {
+            threadsCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // a thread or an affinity that fails partway stops the workers already started
+        try
+        {
+            const auto cpus = GetCpus(affinity);
+            for (unsigned worker = 0; worker < threadsCount; ++worker)
+            {
+                m_threads.emplace_back([this, worker] { Work(worker); });
+                if (!cpus.empty())
+                {
+                    PinThread(m_threads.back(), cpus[worker % cpus.size()]);
+                }
+            }
+        }
+        catch (...)
+        {
+            Stop();
+            throw;
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool()
+    {
+        Stop();
+    }
+
+    [[nodiscard]] size_t GetWorkersCount() const
+    {
+        return m_threads.size();
+    }
+
+    // Slice of [0, itemsCount) given to the worker
+    static std::pair<size_t, size_t> GetRange(const size_t itemsCount, const size_t workersCount, const size_t worker)
+    {
+        return { itemsCount * worker / workersCount, itemsCount * (worker + 1) / workersCount };
+    }
+
+    // Calls task(worker, begin, end) once for every worker's slice of [0, itemsCount) and waits for all of them.
+    // The first exception thrown by a task is rethrown here. Not reentrant: one Run at a time
+    template <typename Task>
+    void Run(const size_t itemsCount, Task&& task)
+    {
+        const size_t workersCount = GetWorkersCount();
+        if (itemsCount < MIN_PARALLEL_ITEMS || workersCount == 1)
+        {
+            for (size_t worker = 0; worker < workersCount; ++worker)
+            {
+                auto [begin, end] = GetRange(itemsCount, workersCount, worker);
+                task(worker, begin, end);
+            }
+            return;
+        }
+
+        std::unique_lock lock(m_mutex);
+        m_task = [&task, itemsCount, workersCount](const size_t worker) {
+            auto [begin, end] = GetRange(itemsCount, workersCount, worker);
+            task(worker, begin, end);
+        };
+        m_error = nullptr;
+        m_pendingCount = workersCount;
+        ++m_generation;
+        m_startCondition.notify_all();
+
+        m_doneCondition.wait(lock, [this] { return m_pendingCount == 0; });
+        m_task = nullptr;
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+private:
+    void Stop()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_isStopped = true;
+        }
+        m_startCondition.notify_all();
+
+        for (auto& thread: m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    void Work(const size_t worker)
+    {
+        uint64_t generation = 0;
+        while (true)
+        {
+            std::function<void(size_t)> task;
+            {
+                std::unique_lock lock(m_mutex);
+                m_startCondition.wait(lock, [this, generation] { return m_isStopped || m_generation != generation; });
+                if (m_isStopped)
+                {
+                    return;
+                }
+
+                generation = m_generation;
+                task = m_task;
+            }
+
+            std::exception_ptr error;
+            try
+            {
+                task(worker);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            std::lock_guard lock(m_mutex);
+            if (error && !m_error)
+            {
+                m_error = error;
+            }
+            if (--m_pendingCount == 0)
+            {
+                m_doneCondition.notify_one();
+            }
+        }
+    }
+
+    // "0-3,8-11" as in /sys/devices/system/node/node*/cpulist
+    static std::vector<unsigned> ParseCpuList(const std::string& cpuList)
+    {
+        std::vector<unsigned> cpus;
+        std::stringstream ss(cpuList);
+        std::string range;
+        while (std::getline(ss, range, ','))
+        {
+            if (range.empty())
+            {
+                continue;
+            }
+
+            const size_t dashPos = range.find('-');
+            const unsigned first = std::stoul(range.substr(0, dashPos));
+            const unsigned last = dashPos == std::string::npos ? first : std::stoul(range.substr(dashPos + 1));
+            for (unsigned cpu = first; cpu <= last; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+
+        return cpus;
+    }
+
+    // CPUs in the order threads are pinned to them, empty if threads are not pinned
+    static std::vector<unsigned> GetCpus(const Affinity affinity)
+    {
+        std::vector<unsigned> cpus;
+#ifdef __linux__
+        if (affinity == Affinity::None)
+        {
+            return cpus;
+        }
+
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        {
+            return cpus;
+        }
+
+        // CPUs of every memory node this process may run on
+        std::vector<std::vector<unsigned>> nodes;
+        for (unsigned node = 0; ; ++node)
+        {
+            std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!cpuList.is_open())
+            {
+                break;
+            }
+
+            std::string line;
+            std::getline(cpuList, line);
+            std::vector<unsigned> nodeCpus;
+            for (auto cpu: ParseCpuList(line))
+            {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                {
+                    nodeCpus.push_back(cpu);
+                }
+            }
+            if (!nodeCpus.empty())
+            {
+                nodes.push_back(std::move(nodeCpus));
+            }
+        }
+
+        if (nodes.empty())
+        {
+            nodes.emplace_back();
+            for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &allowed))
+                {
+                    nodes.back().push_back(cpu);
+                }
+            }
+        }
+
+        if (affinity == Affinity::Compact)
+        {
+            for (auto& nodeCpus: nodes)
+            {
+                cpus.insert(cpus.end(), nodeCpus.begin(), nodeCpus.end());
+            }
+            return cpus;
+        }
+
+        size_t cpusCount = 0;
+        for (auto& nodeCpus: nodes)
+        {
+            cpusCount += nodeCpus.size();
+        }
+        for (size_t i = 0; cpus.size() < cpusCount; ++i)
+        {
+            for (auto& nodeCpus: nodes)
+            {
+                if (i < nodeCpus.size())
+                {
+                    cpus.push_back(nodeCpus[i]);
+                }
+            }
+        }
+#else
+        (void)affinity;
+#endif
+        return cpus;
+    }
+
+    // Pinning is a hint: a CPU taken away by the scheduler leaves the thread unpinned
+    static void PinThread(std::thread& thread, const unsigned cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)cpu;
+#endif
+    }
+
+    std::vector<std::thread> m_threads;
+    std::function<void(size_t)> m_task;
+    std::exception_ptr m_error;
+    std::mutex m_mutex;
+    std::condition_variable m_startCondition;
+    std::condition_variable m_doneCondition;
+    uint64_t m_generation = 0;
+    size_t m_pendingCount = 0;
+    bool m_isStopped = false;
+};
+
+// Without a pool the whole range is one slice of worker 0 on the calling thread
+template <typename Task>
+void RunByRanges(WorkerPool* pool, const size_t itemsCount, Task&& task)
+{
+    if (pool)
+    {
+        pool->Run(itemsCount, std::forward<Task>(task));
+    }
+    else
+    {
+        task(0, 0, itemsCount);
+    }
+}
+
+#endif
@@ -0,0 +1,326 @@
+// Throughput benchmark on a corpus of generated automata: every case is loaded from CSV text,
+// minimized and exported, the best of several runs is reported per phase.
+//
+// usage: mealy_moore_benchmark [--scale=<factor>] [--repeat=<n>] [--threads=<n>] [--output=<file>]
+//     [--baseline=<file> [--threshold=<fraction>]] [--write-corpus=<dir>]
+//
+// --output saves the throughputs, --baseline compares against saved ones and fails when a phase of a case
+// is slower than the baseline by more than the threshold. --write-corpus only writes the corpus CSV files,
+// named <mealy|moore>-<case>.csv, for training runs of the main executable
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../AutomataController.h"
+#include "../tests/AutomataGenerator.h"
+
+namespace
+{
+    const std::string SCALE_OPTION = "--scale=";
+    const std::string REPEAT_OPTION = "--repeat=";
+    const std::string THREADS_OPTION = "--threads=";
+    const std::string OUTPUT_OPTION = "--output=";
+    const std::string BASELINE_OPTION = "--baseline=";
+    const std::string THRESHOLD_OPTION = "--threshold=";
+    const std::string WRITE_CORPUS_OPTION = "--write-corpus=";
+
+    struct Config
+    {
+        double scale = 1.0;
+        size_t repeatCount = 3;
+        // 0 means one thread per hardware thread, as in the main executable
+        unsigned threadsCount = 0;
+        std::string outputFilename;
+        std::string baselineFilename;
+        // allowed slowdown against the baseline
+        double threshold = 0.1;
+        std::string corpusDirectory;
+    };
+
+    struct Case
+    {
+        std::string name;
+        AutomataGenerator::Options options;
+    };
+
+    // Load and export throughput is in MB of CSV per second, minimization in millions of states per second
+    struct Throughput
+    {
+        double load = 0;
+        double minimize = 0;
+        double write = 0;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double GetSeconds(const Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    Config ParseConfig(const int argc, char* argv[])
+    {
+        Config config;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (arg.starts_with(SCALE_OPTION))
+            {
+                config.scale = std::stod(arg.substr(SCALE_OPTION.size()));
+            }
+            else if (arg.starts_with(REPEAT_OPTION))
+            {
+                config.repeatCount = std::max<size_t>(1, std::stoul(arg.substr(REPEAT_OPTION.size())));
+            }
+            else if (arg.starts_with(THREADS_OPTION))
+            {
+                config.threadsCount = static_cast<unsigned>(std::stoul(arg.substr(THREADS_OPTION.size())));
+            }
+            else if (arg.starts_with(OUTPUT_OPTION))
+            {
+                config.outputFilename = arg.substr(OUTPUT_OPTION.size());
+            }
+            else if (arg.starts_with(BASELINE_OPTION))
+            {
+                config.baselineFilename = arg.substr(BASELINE_OPTION.size());
+            }
+            else if (arg.starts_with(THRESHOLD_OPTION))
+            {
+                config.threshold = std::stod(arg.substr(THRESHOLD_OPTION.size()));
+            }
+            else if (arg.starts_with(WRITE_CORPUS_OPTION))
+            {
+                config.corpusDirectory = arg.substr(WRITE_CORPUS_OPTION.size());
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown argument: " + arg);
+            }
+        }
+
+        return config;
+    }
+
+    // Shapes the algorithm choice depends on: planted classes merge many states, random tables are
+    // almost minimal, partial tables have a sink in Hopcroft, a wide alphabet makes long rows,
+    // a sparse one has few of them defined, a chain needs a round per state in the round-based engines
+    std::vector<Case> GetCorpus(const double scale)
+    {
+        using AutomataGenerator::Kind;
+        auto scaled = [scale](const size_t statesCount) {
+            return std::max<size_t>(1, static_cast<size_t>(static_cast<double>(statesCount) * scale));
+        };
+        auto makeCase = [](std::string name, const Kind kind, const size_t statesCount, const size_t inputsCount,
+            const size_t classesCount, const double definedRatio) {
+            AutomataGenerator::Options options;
+            options.kind = kind;
+            options.statesCount = statesCount;
+            options.inputsCount = inputsCount;
+            options.classesCount = classesCount;
+            options.definedRatio = definedRatio;
+            return Case { (kind == Kind::Mealy ? "mealy-" : "moore-") + name, options };
+        };
+        auto chainCase = [](Case chain) {
+            chain.options.isChain = true;
+            return chain;
+        };
+
+        return {
+            makeCase("planted", Kind::Mealy, scaled(200000), 4, scaled(20000), 1.0),
+            makeCase("random-partial", Kind::Mealy, scaled(100000), 8, scaled(100000), 0.8),
+            makeCase("wide", Kind::Mealy, scaled(20000), 64, scaled(5000), 0.5),
+            makeCase("sparse", Kind::Mealy, scaled(20000), 400, scaled(20000), 0.02),
+            makeCase("planted", Kind::Moore, scaled(200000), 4, scaled(20000), 1.0),
+            makeCase("random", Kind::Moore, scaled(100000), 2, scaled(100000), 1.0),
+            chainCase(makeCase("chain", Kind::Moore, scaled(140000), 4, scaled(140000), 1.0)),
+        };
+    }
+
+    std::string GetCsv(const AutomataGenerator::IndexedAutomata& indexed)
+    {
+        std::ostringstream csv;
+        if (indexed.kind == AutomataGenerator::Kind::Mealy)
+        {
+            AutomataGenerator::ToMealyAutomata(indexed).WriteCsv(csv);
+        }
+        else
+        {
+            AutomataGenerator::ToMooreAutomata(indexed).WriteCsv(csv);
+        }
+
+        return csv.str();
+    }
+
+    void WriteCorpus(const std::vector<Case>& corpus, const std::string& directory)
+    {
+        std::filesystem::create_directories(directory);
+        for (size_t i = 0; i < corpus.size(); ++i)
+        {
+            std::mt19937 random(static_cast<unsigned>(i));
+            const auto path = std::filesystem::path(directory) / (corpus[i].name + ".csv");
+            std::ofstream file(path, std::ios::binary);
+            file << GetCsv(AutomataGenerator::Generate(corpus[i].options, random));
+            if (!file)
+            {
+                throw std::runtime_error("Could not write " + path.string());
+            }
+        }
+    }
+
+    Throughput RunCase(const Case& benchmarkCase, const std::string& csv, const size_t repeatCount,
+        WorkerPool& pool, std::string& algorithmName)
+    {
+        const Automata automataKind = benchmarkCase.options.kind == AutomataGenerator::Kind::Mealy
+            ? Automata::Mealy
+            : Automata::Moore;
+        const double megabytes = static_cast<double>(csv.size()) / 1e6;
+        const double megastates = static_cast<double>(benchmarkCase.options.statesCount) / 1e6;
+
+        Throughput best;
+        for (size_t run = 0; run < repeatCount; ++run)
+        {
+            std::istringstream input(csv);
+            auto start = Clock::now();
+            auto automata = GetAutomataFromCsv(automataKind, input);
+            best.load = std::max(best.load, megabytes / GetSeconds(start));
+
+            automata->SetWorkerPool(&pool);
+            start = Clock::now();
+            const auto stats = automata->Minimize();
+            best.minimize = std::max(best.minimize, megastates / GetSeconds(start));
+            algorithmName = PartitionAlgorithm::GetAlgorithmName(stats.algorithm)
+                + (stats.fallback ? "+" + PartitionAlgorithm::GetAlgorithmName(*stats.fallback) : "");
+
+            std::ostringstream output;
+            start = Clock::now();
+            automata->WriteCsv(output);
+            const double seconds = GetSeconds(start);
+            best.write = std::max(best.write, static_cast<double>(output.tellp()) / 1e6 / seconds);
+        }
+
+        return best;
+    }
+
+    // "<case> <phase> <throughput>" lines
+    std::map<std::string, double> ReadResults(const std::string& filename)
+    {
+        std::ifstream file(filename);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Could not open " + filename);
+        }
+
+        std::map<std::string, double> results;
+        std::string name, phase;
+        for (double throughput; file >> name >> phase >> throughput;)
+        {
+            results[name + " " + phase] = throughput;
+        }
+
+        return results;
+    }
+
+    // Returns the number of regressions
+    size_t CompareResults(const std::map<std::string, double>& baseline, const std::map<std::string, double>& results,
+        const double threshold)
+    {
+        size_t regressionsCount = 0;
+        for (const auto& [key, baselineThroughput]: baseline)
+        {
+            const auto it = results.find(key);
+            if (it == results.end())
+            {
+                std::cerr << "MISSING " << key << std::endl;
+                ++regressionsCount;
+                continue;
+            }
+
+            const double ratio = it->second / baselineThroughput;
+            if (ratio < 1 - threshold)
+            {
+                std::fprintf(stderr, "REGRESSION %s: %.2f -> %.2f (%+.1f%%)\n", key.c_str(), baselineThroughput,
+                    it->second, (ratio - 1) * 100);
+                ++regressionsCount;
+            }
+        }
+
+        return regressionsCount;
+    }
+}
+
+int main(const int argc, char* argv[])
+{
+    size_t regressionsCount = 0;
+    try
+    {
+        const Config config = ParseConfig(argc, argv);
+        const auto corpus = GetCorpus(config.scale);
+        if (!config.corpusDirectory.empty())
+        {
+            WriteCorpus(corpus, config.corpusDirectory);
+            return 0;
+        }
+
+        WorkerPool pool(config.threadsCount);
+        std::map<std::string, double> results;
+
+        std::printf("%-20s %-16s %9s %10s %14s %14s %14s\n", "case", "algorithm", "states", "csv MB",
+            "load MB/s", "Mstates/s", "export MB/s");
+        for (size_t i = 0; i < corpus.size(); ++i)
+        {
+            std::mt19937 random(static_cast<unsigned>(i));
+            const std::string csv = GetCsv(AutomataGenerator::Generate(corpus[i].options, random));
+
+            std::string algorithmName;
+            const Throughput throughput = RunCase(corpus[i], csv, config.repeatCount, pool, algorithmName);
+            std::printf("%-20s %-16s %9zu %10.2f %14.2f %14.3f %14.2f\n", corpus[i].name.c_str(),
+                algorithmName.c_str(), corpus[i].options.statesCount, static_cast<double>(csv.size()) / 1e6,
+                throughput.load, throughput.minimize, throughput.write);
+
+            results[corpus[i].name + " load"] = throughput.load;
+            results[corpus[i].name + " minimize"] = throughput.minimize;
+            results[corpus[i].name + " export"] = throughput.write;
+        }
+
+        if (!config.outputFilename.empty())
+        {
+            std::ofstream output(config.outputFilename);
+            for (const auto& [key, throughput]: results)
+            {
+                output << key << ' ' << throughput << '\n';
+            }
+            if (!output)
+            {
+                throw std::runtime_error("Could not write " + config.outputFilename);
+            }
+        }
+
+        if (!config.baselineFilename.empty())
+        {
+            regressionsCount = CompareResults(ReadResults(config.baselineFilename), results, config.threshold);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    if (regressionsCount != 0)
+    {
+        std::cerr << regressionsCount << " regression(s) beyond the threshold" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+# Training run of a -DMMM_PGO=GENERATE build: minimizes every file of the benchmark corpus with the
+# main executable, then runs the benchmark itself, so both executables leave profiles.
+# Clang profiles are merged into MMM_PGO_DIR/default.profdata for the USE build.
+#
+# cmake -DMINIMIZATION=<exe> -DBENCHMARK=<exe> -DCORPUS_DIR=<dir> -DPGO_DIR=<dir> [-DLLVM_PROFDATA=<exe>]
+#     -P PgoTrain.cmake
+
+file(REMOVE_RECURSE ${CORPUS_DIR})
+execute_process(COMMAND ${BENCHMARK} --write-corpus=${CORPUS_DIR} COMMAND_ERROR_IS_FATAL ANY)
+
+file(GLOB corpus ${CORPUS_DIR}/*.csv)
+foreach(input ${corpus})
+    get_filename_component(name ${input} NAME_WE)
+    string(REGEX MATCH "^[a-z]+" automata ${name})
+    execute_process(COMMAND ${MINIMIZATION} ${automata} ${input} ${CORPUS_DIR}/${name}.min.csv
+            OUTPUT_QUIET COMMAND_ERROR_IS_FATAL ANY)
+endforeach()
+
+execute_process(COMMAND ${BENCHMARK} --repeat=1 COMMAND_ERROR_IS_FATAL ANY)
+
+if(LLVM_PROFDATA)
+    file(GLOB profiles ${PGO_DIR}/*.profraw)
+    execute_process(COMMAND ${LLVM_PROFDATA} merge -output=${PGO_DIR}/default.profdata ${profiles}
+            COMMAND_ERROR_IS_FATAL ANY)
+endif()
@@ -1,43 +1,157 @@
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <sstream>
 
 #include "ArgumentsParser.h"
 #include "AutomataController.h"
+#include "BatchMinimization.h"
+#include "MinimizationServer.h"
+#include "Minimization.h"
+#include "ResultCache.h"
 #include "Automata/IAutomata.h"
+#include "Automata/MealyComposition.h"
+#include "Utils/Trace.h"
 
-void MealyMinimization(Args& args)
+// Messages go to stderr when the table itself is written to stdout
+std::ostream& GetMessageStream(const Args& args)
 {
-    auto automata = MealyController::GetMealyAutomataFromCsvFile(args.inputFilename);
+    return args.outputFilename == STANDARD_STREAM ? std::cerr : std::cout;
+}
+
+void WriteOutput(const Args& args, const std::function<void(std::ostream&)>& write)
+{
+    if (args.outputFilename == STANDARD_STREAM)
+    {
+        WriteCompressed(std::cout, Compression::None, write);
+        return;
+    }
+
+    std::ofstream output(args.outputFilename, std::ios::binary);
+    if (!output.is_open())
+    {
+        throw std::invalid_argument("Could not open file " + args.outputFilename + " for writing");
+    }
+    WriteCompressed(output, GetCompressionByExtension(args.outputFilename), write);
+}
+
+void ProcessAutomata(IAutomata& automata, const Args& args)
+{
+    std::unique_ptr<ResultCache> cache;
+    std::string cacheKey;
+    if (!args.cacheDirectory.empty())
+    {
+        cache = std::make_unique<ResultCache>(args.cacheDirectory, args.cacheSize);
+        cacheKey = GetCacheKey(automata, args);
+
+        // the output is opened only once there is a result to write
+        if (const auto cached = cache->Load(cacheKey))
+        {
+            if (cached->canonicalHash)
+            {
+                GetMessageStream(args) << "Canonical hash: " << *cached->canonicalHash << std::endl;
+            }
+            WriteOutput(args, [&](std::ostream& output) { output << cached->csv; });
+            return;
+        }
+    }
+
+    PartitionAlgorithm::Stats stats;
+    const auto hash = MinimizeAutomata(automata, args, &stats);
+    if (hash)
+    {
+        GetMessageStream(args) << "Canonical hash: " << *hash << std::endl;
+    }
+    if (args.stats && !args.dontCareOutput)
+    {
+        PrintStats(GetMessageStream(args), stats, args);
+    }
 
-    automata->Minimize();
+    if (!cache)
+    {
+        MMM_TRACE_SCOPE("WriteCsv");
+        WriteOutput(args, [&](std::ostream& output) { automata.WriteCsv(output); });
+        return;
+    }
 
-    automata->ExportToCsv(args.outputFilename);
+    // the output and the cache entry share one serialization
+    CachedResult result = { {}, hash };
+    {
+        MMM_TRACE_SCOPE("WriteCsv");
+        std::ostringstream csv;
+        automata.WriteCsv(csv);
+        result.csv = std::move(csv).str();
+        WriteOutput(args, [&](std::ostream& output) { output << result.csv; });
+    }
+    cache->Store(cacheKey, result);
 }
 
-void MooreMinimization(Args& args)
+std::unique_ptr<IAutomata> GetComposedAutomata(const Args& args)
 {
-    auto automata = MooreController::GetMooreAutomataFromCsvFile(args.inputFilename);
+    auto first = MealyController::GetMealyAutomataFromCsvFile(args.inputFilename);
+    auto second = MealyController::GetMealyAutomataFromCsvFile(args.secondInputFilename);
 
-    automata->Minimize();
+    return args.command == Command::Product
+        ? MealyComposition::GetParallelProduct(*first, *second)
+        : MealyComposition::GetSerialComposition(*first, *second);
+}
 
-    automata->ExportToCsv(args.outputFilename);
+void StartTrace(const Args& args)
+{
+#ifdef MMM_ENABLE_TRACING
+    if (args.command == Command::Serve)
+    {
+        throw std::invalid_argument("Option " + TRACE_OPTION + " is not supported in server mode");
+    }
+    Trace::Recorder::Get().Start();
+#else
+    (void)args;
+    throw std::invalid_argument("Tracing is compiled out, configure with -DMMM_TRACING=ON");
+#endif
 }
 
 int main(const int argc, char** argv)
 {
     try
     {
-        switch (Args args = ParseArgs(argc, argv); args.automata)
+        Args args = ParseArgs(argc, argv);
+        if (!args.traceFilename.empty())
+        {
+            StartTrace(args);
+        }
+        if (args.command == Command::Serve)
+        {
+            MinimizationServer server(args);
+            server.Run();
+            return 0;
+        }
+
+        if (args.command == Command::Batch)
+        {
+            BatchMinimization(args).Run(GetMessageStream(args));
+        }
+        else
+        {
+            std::optional<WorkerPool> pool;
+            auto automata = args.command == Command::Minimize
+                ? GetAutomataFromCsvFile(args.automata, args.inputFilename)
+                : GetComposedAutomata(args);
+            // the parallel phases split the states into ranges, a table smaller than one range runs
+            // on the calling thread anyway, so the workers are started only for a large one
+            if (automata->GetStatesCount() >= WorkerPool::MIN_PARALLEL_ITEMS)
+            {
+                pool.emplace(args.threadsCount, args.affinity);
+                automata->SetWorkerPool(&*pool);
+            }
+            ProcessAutomata(*automata, args);
+        }
+        if (!args.traceFilename.empty())
         {
-            case Automata::Mealy:
-                MealyMinimization(args);
-                break;
-            case Automata::Moore:
-                MooreMinimization(args);
-                break;
-            default: break;
+            Trace::Recorder::Get().Write(args.traceFilename);
         }
 
-        std::cout << "Executed!\n";
+        GetMessageStream(args) << "Executed!\n";
     }
     catch (const std::exception& err)
     {
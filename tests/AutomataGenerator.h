@@ -0,0 +1,287 @@
+#pragma once
+#ifndef AUTOMATA_GENERATOR_H
+#define AUTOMATA_GENERATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Automata/MealyAutomata.h"
+#include "../Automata/MooreAutomata.h"
+
+// Random automata in index form for tests and benchmarks
+namespace AutomataGenerator
+{
+    constexpr uint32_t NO_STATE = std::numeric_limits<uint32_t>::max();
+
+    enum class Kind
+    {
+        Mealy,
+        Moore
+    };
+
+    struct IndexedAutomata
+    {
+        Kind kind;
+        size_t statesCount;
+        size_t inputsCount;
+        // nextStates[state * inputsCount + input], NO_STATE for an undefined transition
+        std::vector<uint32_t> nextStates;
+        // Mealy: outputs[state * inputsCount + input], Moore: outputs[state]
+        std::vector<uint32_t> outputs;
+    };
+
+    struct Options
+    {
+        Kind kind = Kind::Mealy;
+        size_t statesCount = 100;
+        size_t inputsCount = 3;
+        size_t outputsCount = 2;
+        // states are copies of this many planted classes, so the minimal automata has at most that many states
+        size_t classesCount = 25;
+        // probability of a defined transition, 1 gives a complete automata
+        double definedRatio = 1.0;
+        // input i repeats the column of input i % inputClassesCount in every state, 0 makes all inputs independent
+        size_t inputClassesCount = 0;
+        // the planted classes form a chain: class c moves to class c + 1 on input 0 and back to c - i on input i,
+        // only the last class outputs 1, so telling the first class apart takes classesCount steps.
+        // The automata is complete
+        bool isChain = false;
+    };
+
+    inline IndexedAutomata Generate(const Options& options, std::mt19937& random)
+    {
+        const size_t n = options.statesCount;
+        const size_t k = options.inputsCount;
+        const size_t classesCount = std::max<size_t>(1, std::min(options.classesCount, n));
+
+        std::uniform_int_distribution<uint32_t> classDistribution(0, static_cast<uint32_t>(classesCount - 1));
+        std::uniform_int_distribution<uint32_t> outputDistribution(0, static_cast<uint32_t>(options.outputsCount - 1));
+        std::bernoulli_distribution isDefined(options.definedRatio);
+
+        // transitions and outputs of the planted classes
+        std::vector<uint32_t> classNext(classesCount * k);
+        std::vector<uint32_t> classOutputs(classesCount * (options.kind == Kind::Mealy ? k : 1));
+        for (size_t i = 0; i < classNext.size(); ++i)
+        {
+            classNext[i] = isDefined(random) ? classDistribution(random) : NO_STATE;
+        }
+        for (auto& output: classOutputs)
+        {
+            output = outputDistribution(random);
+        }
+        if (options.isChain)
+        {
+            const size_t outputsPerClass = classOutputs.size() / classesCount;
+            for (size_t classIndex = 0; classIndex < classesCount; ++classIndex)
+            {
+                classNext[classIndex * k] = static_cast<uint32_t>(std::min(classIndex + 1, classesCount - 1));
+                for (size_t input = 1; input < k; ++input)
+                {
+                    classNext[classIndex * k + input] = static_cast<uint32_t>(classIndex - std::min(classIndex, input));
+                }
+                std::fill_n(classOutputs.begin() + classIndex * outputsPerClass, outputsPerClass,
+                    classIndex + 1 == classesCount ? 1 : 0);
+            }
+        }
+
+        // state s belongs to class s % classesCount and moves to a random member of the target class
+        IndexedAutomata automata { options.kind, n, k, std::vector<uint32_t>(n * k), {} };
+        for (size_t state = 0; state < n; ++state)
+        {
+            const size_t stateClass = state % classesCount;
+            for (size_t input = 0; input < k; ++input)
+            {
+                const uint32_t targetClass = classNext[stateClass * k + input];
+                if (targetClass == NO_STATE)
+                {
+                    automata.nextStates[state * k + input] = NO_STATE;
+                    continue;
+                }
+
+                const size_t membersCount = (n - 1 - targetClass) / classesCount + 1;
+                std::uniform_int_distribution<size_t> memberDistribution(0, membersCount - 1);
+                automata.nextStates[state * k + input] = static_cast<uint32_t>(
+                    targetClass + classesCount * memberDistribution(random));
+            }
+
+            if (options.kind == Kind::Mealy)
+            {
+                automata.outputs.insert(automata.outputs.end(),
+                    classOutputs.begin() + stateClass * k, classOutputs.begin() + (stateClass + 1) * k);
+            }
+            else
+            {
+                automata.outputs.push_back(classOutputs[stateClass]);
+            }
+        }
+
+        for (size_t input = options.inputClassesCount; options.inputClassesCount != 0 && input < k; ++input)
+        {
+            const size_t classInput = input % options.inputClassesCount;
+            for (size_t state = 0; state < n; ++state)
+            {
+                automata.nextStates[state * k + input] = automata.nextStates[state * k + classInput];
+                if (options.kind == Kind::Mealy)
+                {
+                    automata.outputs[state * k + input] = automata.outputs[state * k + classInput];
+                }
+            }
+        }
+
+        return automata;
+    }
+
+    // Renumbers all states but the start state, the result is the same automata under other names
+    inline IndexedAutomata Shuffle(const IndexedAutomata& automata, std::mt19937& random)
+    {
+        std::vector<uint32_t> newIndexes(automata.statesCount);
+        std::iota(newIndexes.begin(), newIndexes.end(), 0);
+        if (newIndexes.size() > 1)
+        {
+            std::shuffle(newIndexes.begin() + 1, newIndexes.end(), random);
+        }
+
+        const size_t k = automata.inputsCount;
+        const size_t outputsPerState = automata.kind == Kind::Mealy ? k : 1;
+        IndexedAutomata result { automata.kind, automata.statesCount, k,
+            std::vector<uint32_t>(automata.nextStates.size()), std::vector<uint32_t>(automata.outputs.size()) };
+        for (size_t state = 0; state < automata.statesCount; ++state)
+        {
+            const size_t newState = newIndexes[state];
+            for (size_t input = 0; input < k; ++input)
+            {
+                const uint32_t next = automata.nextStates[state * k + input];
+                result.nextStates[newState * k + input] = next == NO_STATE ? NO_STATE : newIndexes[next];
+            }
+            std::copy_n(automata.outputs.begin() + state * outputsPerState, outputsPerState,
+                result.outputs.begin() + newState * outputsPerState);
+        }
+
+        return result;
+    }
+
+    inline std::string GetStateName(const size_t state)
+    {
+        return "s" + std::to_string(state);
+    }
+
+    inline std::string GetInputName(const size_t input)
+    {
+        return "x" + std::to_string(input);
+    }
+
+    inline std::string GetOutputName(const size_t output)
+    {
+        return "y" + std::to_string(output);
+    }
+
+    // A column of defined transitions per input, Mealy transitions keep their outputs
+    inline AutomataTable ToAutomataTable(const IndexedAutomata& automata)
+    {
+        std::vector<State> states;
+        for (size_t state = 0; state < automata.statesCount; ++state)
+        {
+            states.push_back(GetStateName(state));
+        }
+
+        const bool isMealy = automata.kind == Kind::Mealy;
+        AutomataTableBuilder builder(std::move(states));
+        for (size_t state = 0; !isMealy && state < automata.statesCount; ++state)
+        {
+            builder.AddStateOutput(GetOutputName(automata.outputs[state]));
+        }
+
+        for (size_t input = 0; input < automata.inputsCount; ++input)
+        {
+            TransitionColumn transitions;
+            for (size_t state = 0; state < automata.statesCount; ++state)
+            {
+                const size_t pos = state * automata.inputsCount + input;
+                if (automata.nextStates[pos] != NO_STATE)
+                {
+                    transitions.push_back({ static_cast<uint32_t>(state), automata.nextStates[pos],
+                        isMealy ? builder.GetOutputId(GetOutputName(automata.outputs[pos])) : 0 });
+                }
+            }
+            builder.AddInput(GetInputName(input), std::move(transitions));
+        }
+
+        return builder.Release(isMealy);
+    }
+
+    inline MealyAutomata ToMealyAutomata(const IndexedAutomata& automata)
+    {
+        return MealyAutomata(ToAutomataTable(automata));
+    }
+
+    inline MooreAutomata ToMooreAutomata(const IndexedAutomata& automata)
+    {
+        return MooreAutomata(ToAutomataTable(automata));
+    }
+
+    // Names written by the generator end with their index
+    inline uint32_t GetNameIndex(const std::string& name)
+    {
+        return static_cast<uint32_t>(std::stoul(name.substr(1)));
+    }
+
+    // Reads a table back into index form, the first state is the start state.
+    // Inputs missing from the table stay undefined
+    inline IndexedAutomata FromAutomataTable(const AutomataTable& table, const Kind kind, const size_t inputsCount)
+    {
+        const size_t statesCount = table.states.size();
+        IndexedAutomata result { kind, statesCount, inputsCount,
+            std::vector<uint32_t>(statesCount * inputsCount, NO_STATE), {} };
+        if (kind == Kind::Mealy)
+        {
+            result.outputs.assign(statesCount * inputsCount, 0);
+        }
+        for (auto output: table.stateOutputs)
+        {
+            result.outputs.push_back(GetNameIndex(table.outputSymbols[output]));
+        }
+
+        std::vector<std::vector<uint32_t>> classInputs(table.classesCount);
+        for (auto& [inputSymbol, inputClass]: table.inputs)
+        {
+            classInputs[inputClass].push_back(GetNameIndex(inputSymbol));
+        }
+
+        const auto& transitions = table.transitions;
+        for (size_t state = 0; state < statesCount; ++state)
+        {
+            for (auto i = transitions.rowOffsets[state]; i < transitions.rowOffsets[state + 1]; ++i)
+            {
+                for (auto input: classInputs[transitions.inputs[i]])
+                {
+                    result.nextStates[state * inputsCount + input] = transitions.targets[i];
+                    if (kind == Kind::Mealy)
+                    {
+                        result.outputs[state * inputsCount + input] =
+                            GetNameIndex(table.outputSymbols[table.transitionOutputs[i]]);
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    inline IndexedAutomata FromMealyAutomata(const MealyAutomata& automata, const size_t inputsCount)
+    {
+        return FromAutomataTable(automata.GetTable(), Kind::Mealy, inputsCount);
+    }
+
+    inline IndexedAutomata FromMooreAutomata(const MooreAutomata& automata, const size_t inputsCount)
+    {
+        return FromAutomataTable(automata.GetTable(), Kind::Moore, inputsCount);
+    }
+}
+
+#endif
@@ -0,0 +1,69 @@
+# End-to-end check of the minimization executable on a checked-in fixture, run by ctest as
+# cmake -DEXECUTABLE=<file> -DARGS=<arguments> -DOUTPUT=<file> -DEXPECTED=<file> [-DREAD_BACK=mealy|moore]
+#     [-DCACHE_DIR=<dir>] -P EndToEnd.cmake
+# ARGS is the command line without the executable and writes OUTPUT, which must match EXPECTED.
+# READ_BACK: OUTPUT is compressed, it is read back by minimizing it again into plain CSV before the comparison.
+# CACHE_DIR: the command runs twice on an emptied cache directory, the second run must be a cache hit
+# that prints the canonical hash of the first one
+
+foreach(variable EXECUTABLE ARGS OUTPUT EXPECTED)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "${variable} is not set")
+    endif()
+endforeach()
+
+function(run_executable messages)
+    execute_process(COMMAND ${EXECUTABLE} ${ARGN}
+            RESULT_VARIABLE result
+            OUTPUT_VARIABLE output
+            ERROR_VARIABLE error)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${EXECUTABLE} ${ARGN} failed with ${result}:\n${output}${error}")
+    endif()
+    set(${messages} "${output}" PARENT_SCOPE)
+endfunction()
+
+function(check_output)
+    set(actual ${OUTPUT})
+    if(DEFINED READ_BACK)
+        set(actual ${OUTPUT}.read_back.csv)
+        run_executable(ignored ${READ_BACK} ${OUTPUT} ${actual})
+    endif()
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files --ignore-eol ${actual} ${EXPECTED}
+            RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        file(READ ${actual} content)
+        message(FATAL_ERROR "${actual} differs from ${EXPECTED}:\n${content}")
+    endif()
+endfunction()
+
+function(get_canonical_hash messages hash)
+    if(NOT messages MATCHES "Canonical hash: ([0-9a-f]+)")
+        message(FATAL_ERROR "No canonical hash in:\n${messages}")
+    endif()
+    set(${hash} ${CMAKE_MATCH_1} PARENT_SCOPE)
+endfunction()
+
+file(REMOVE ${OUTPUT})
+if(NOT DEFINED CACHE_DIR)
+    run_executable(messages ${ARGS})
+    check_output()
+    return()
+endif()
+
+# the first run minimizes and prints the statistics, the hit skips the minimization and prints none
+file(REMOVE_RECURSE ${CACHE_DIR})
+run_executable(missMessages ${ARGS} --cache-dir=${CACHE_DIR} --stats)
+check_output()
+get_canonical_hash("${missMessages}" missHash)
+
+file(REMOVE ${OUTPUT})
+run_executable(hitMessages ${ARGS} --cache-dir=${CACHE_DIR} --stats)
+check_output()
+get_canonical_hash("${hitMessages}" hitHash)
+if(hitMessages MATCHES "Algorithm:")
+    message(FATAL_ERROR "The second run was not a cache hit:\n${hitMessages}")
+endif()
+if(NOT hitHash STREQUAL missHash)
+    message(FATAL_ERROR "The cache hit printed hash ${hitHash} instead of ${missHash}")
+endif()
@@ -0,0 +1,327 @@
+// Differential stress test: random Mealy and Moore automata of growing size are minimized by the
+// worklist engine and checked against the reference minimizer. Prints timings per size.
+//
+// usage: mealy_moore_stress_test [--max-states=<n>] [--seeds=<n>] [--inputs=<n>] [--input-classes=<n>]
+//     [--threads=<n>] [--algorithm=auto|iterative|hopcroft|parallel|brzozowski|all]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "AutomataGenerator.h"
+#include "ReferenceMinimizer.h"
+
+namespace
+{
+    const std::string MAX_STATES_OPTION = "--max-states=";
+    const std::string SEEDS_OPTION = "--seeds=";
+    const std::string INPUTS_OPTION = "--inputs=";
+    const std::string INPUT_CLASSES_OPTION = "--input-classes=";
+    const std::string THREADS_OPTION = "--threads=";
+    const std::string ALGORITHM_OPTION = "--algorithm=";
+    const std::string ALL_ALGORITHMS = "all";
+    constexpr size_t MAX_CHAIN_LENGTH = 1000;
+
+    struct Config
+    {
+        size_t maxStates = 10000;
+        size_t seedsCount = 3;
+        size_t inputsCount = 3;
+        // inputs repeat the columns of this many inputs, 0 makes them independent
+        size_t inputClassesCount = 0;
+        // minimization of large automata runs its parallel phases on this many workers
+        unsigned threadsCount = 4;
+        std::vector<PartitionAlgorithm::Algorithm> algorithms = { PartitionAlgorithm::Algorithm::Auto };
+    };
+
+    struct CaseResult
+    {
+        size_t minimizedCount = 0;
+        double minimizeMs = 0;
+        double referenceMs = 0;
+        double checkMs = 0;
+        std::string algorithmName;
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    double GetMilliseconds(const Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    Config ParseConfig(const int argc, char* argv[])
+    {
+        Config config;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (arg.starts_with(MAX_STATES_OPTION))
+            {
+                config.maxStates = std::stoul(arg.substr(MAX_STATES_OPTION.size()));
+            }
+            else if (arg.starts_with(SEEDS_OPTION))
+            {
+                config.seedsCount = std::stoul(arg.substr(SEEDS_OPTION.size()));
+            }
+            else if (arg.starts_with(INPUTS_OPTION))
+            {
+                config.inputsCount = std::stoul(arg.substr(INPUTS_OPTION.size()));
+            }
+            else if (arg.starts_with(INPUT_CLASSES_OPTION))
+            {
+                config.inputClassesCount = std::stoul(arg.substr(INPUT_CLASSES_OPTION.size()));
+            }
+            else if (arg.starts_with(THREADS_OPTION))
+            {
+                config.threadsCount = static_cast<unsigned>(std::stoul(arg.substr(THREADS_OPTION.size())));
+            }
+            else if (arg.starts_with(ALGORITHM_OPTION))
+            {
+                const std::string algorithm = arg.substr(ALGORITHM_OPTION.size());
+                config.algorithms = algorithm == ALL_ALGORITHMS
+                    ? std::vector {
+                        PartitionAlgorithm::Algorithm::Auto,
+                        PartitionAlgorithm::Algorithm::Iterative,
+                        PartitionAlgorithm::Algorithm::Hopcroft,
+                        PartitionAlgorithm::Algorithm::Parallel,
+                        PartitionAlgorithm::Algorithm::Brzozowski }
+                    : std::vector { PartitionAlgorithm::ParseAlgorithm(algorithm) };
+            }
+            else
+            {
+                throw std::invalid_argument("Unknown argument: " + arg);
+            }
+        }
+
+        return config;
+    }
+
+    // Random words give the same outputs on the minimized automata as on the original one,
+    // and a word stops at the same undefined transition
+    void CheckSimulation(const AutomataGenerator::IndexedAutomata& indexed, const MealyAutomata& minimized,
+        std::mt19937& random)
+    {
+        if (indexed.statesCount == 0 || indexed.inputsCount == 0)
+        {
+            return;
+        }
+
+        std::uniform_int_distribution<uint32_t> inputDistribution(0, static_cast<uint32_t>(indexed.inputsCount - 1));
+        for (size_t wordIndex = 0; wordIndex < 16; ++wordIndex)
+        {
+            std::vector<uint32_t> word(wordIndex * 2);
+            for (auto& input: word)
+            {
+                input = inputDistribution(random);
+            }
+
+            const auto expected = ReferenceMinimizer::Simulate(indexed, word);
+            std::vector<InputSymbol> symbols;
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                symbols.push_back(AutomataGenerator::GetInputName(word[i]));
+            }
+
+            const auto outputs = minimized.Simulate(symbols);
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                if (outputs[i] != AutomataGenerator::GetOutputName(expected[i]))
+                {
+                    throw std::runtime_error("simulation gives another output at position " + std::to_string(i));
+                }
+            }
+
+            if (expected.size() < word.size())
+            {
+                symbols.push_back(AutomataGenerator::GetInputName(word[expected.size()]));
+                try
+                {
+                    (void)minimized.Simulate(symbols);
+                }
+                catch (const std::runtime_error&)
+                {
+                    continue;
+                }
+                throw std::runtime_error("simulation passes an undefined transition");
+            }
+        }
+    }
+
+    // Minimizes the automata and a renamed copy of it, both must agree with the reference
+    // and give the same canonical hash
+    template <typename Automata>
+    CaseResult RunCase(
+        const AutomataGenerator::IndexedAutomata& indexed,
+        std::mt19937& random,
+        const PartitionAlgorithm::Algorithm algorithm,
+        WorkerPool& pool,
+        Automata (*toAutomata)(const AutomataGenerator::IndexedAutomata&),
+        AutomataGenerator::IndexedAutomata (*fromAutomata)(const Automata&, size_t))
+    {
+        CaseResult result;
+
+        Automata automata = toAutomata(indexed);
+        automata.SetWorkerPool(&pool);
+        auto start = Clock::now();
+        const auto stats = automata.Minimize(algorithm);
+        result.minimizeMs = GetMilliseconds(start);
+        result.algorithmName = (algorithm == PartitionAlgorithm::Algorithm::Auto ? "auto:" : "")
+            + PartitionAlgorithm::GetAlgorithmName(stats.algorithm) + (stats.fallback ? "+" + PartitionAlgorithm::GetAlgorithmName(*stats.fallback) : "");
+
+        start = Clock::now();
+        const size_t expectedCount = ReferenceMinimizer::GetMinimalStatesCount(indexed);
+        result.referenceMs = GetMilliseconds(start);
+
+        start = Clock::now();
+        const auto minimized = fromAutomata(automata, indexed.inputsCount);
+        result.minimizedCount = minimized.statesCount;
+        if (minimized.statesCount != expectedCount)
+        {
+            throw std::runtime_error("expected " + std::to_string(expectedCount) + " states, got "
+                + std::to_string(minimized.statesCount));
+        }
+
+        std::string error;
+        if (!ReferenceMinimizer::AreEquivalent(indexed, minimized, error))
+        {
+            throw std::runtime_error("minimized automata is not equivalent: " + error);
+        }
+        if constexpr (std::is_same_v<Automata, MealyAutomata>)
+        {
+            CheckSimulation(indexed, automata, random);
+        }
+
+        Automata shuffled = toAutomata(AutomataGenerator::Shuffle(indexed, random));
+        shuffled.Minimize(algorithm);
+        if (shuffled.GetCanonicalHash() != automata.GetCanonicalHash())
+        {
+            throw std::runtime_error("canonical hash depends on state names");
+        }
+        result.checkMs = GetMilliseconds(start);
+
+        return result;
+    }
+
+    CaseResult RunCase(const AutomataGenerator::IndexedAutomata& indexed, std::mt19937& random,
+        const PartitionAlgorithm::Algorithm algorithm, WorkerPool& pool)
+    {
+        if (indexed.kind == AutomataGenerator::Kind::Mealy)
+        {
+            return RunCase<MealyAutomata>(indexed, random, algorithm, pool,
+                AutomataGenerator::ToMealyAutomata, AutomataGenerator::FromMealyAutomata);
+        }
+
+        return RunCase<MooreAutomata>(indexed, random, algorithm, pool,
+            AutomataGenerator::ToMooreAutomata, AutomataGenerator::FromMooreAutomata);
+    }
+    // Runs every seed of one automata shape, prints the summed timings. Returns the number of failed seeds
+    size_t RunShape(const AutomataGenerator::Options& options, const std::string& shape,
+        const PartitionAlgorithm::Algorithm algorithm, const size_t seedsCount, WorkerPool& pool)
+    {
+        const char* kind = options.kind == AutomataGenerator::Kind::Mealy ? "mealy" : "moore";
+        size_t failuresCount = 0;
+        CaseResult total;
+        for (size_t seed = 0; seed < seedsCount; ++seed)
+        {
+            std::mt19937 random(static_cast<unsigned>(options.statesCount * 131 + seed));
+            const auto indexed = AutomataGenerator::Generate(options, random);
+            try
+            {
+                const CaseResult result = RunCase(indexed, random, algorithm, pool);
+                total.minimizedCount += result.minimizedCount;
+                total.minimizeMs += result.minimizeMs;
+                total.referenceMs += result.referenceMs;
+                total.checkMs += result.checkMs;
+                total.algorithmName = result.algorithmName;
+            }
+            catch (const std::exception& e)
+            {
+                ++failuresCount;
+                std::cerr << "FAILED " << kind << " " << shape << " " << PartitionAlgorithm::GetAlgorithmName(algorithm)
+                    << " states=" << options.statesCount << " seed=" << seed << ": " << e.what() << std::endl;
+            }
+        }
+
+        std::printf("%-6s %-8s %-22s %9zu %8zu %9zu %12.2f %12.2f %10.2f\n", kind, shape.c_str(),
+            total.algorithmName.c_str(), options.statesCount, seedsCount,
+            total.minimizedCount / std::max<size_t>(seedsCount, 1), total.minimizeMs, total.referenceMs, total.checkMs);
+
+        return failuresCount;
+    }
+}
+
+int main(const int argc, char* argv[])
+{
+    using AutomataGenerator::Kind;
+
+    size_t failuresCount = 0;
+    try
+    {
+        const Config config = ParseConfig(argc, argv);
+        WorkerPool pool(config.threadsCount);
+
+        std::printf("%-6s %-8s %-22s %9s %8s %9s %12s %12s %10s\n", "kind", "shape", "algorithm",
+            "states", "seeds", "minimal", "minimize ms", "reference ms", "check ms");
+
+        for (size_t statesCount = 1; statesCount <= config.maxStates; statesCount *= 10)
+        {
+            for (const Kind kind: { Kind::Mealy, Kind::Moore })
+            {
+                // planted classes give many mergeable states, random tables are mostly minimal already
+                for (const bool isPlanted: { true, false })
+                {
+                    for (const bool isPartial: { false, true })
+                    {
+                        AutomataGenerator::Options options;
+                        options.kind = kind;
+                        options.statesCount = statesCount;
+                        options.inputsCount = config.inputsCount;
+                        options.inputClassesCount = config.inputClassesCount;
+                        options.classesCount = isPlanted ? statesCount / 4 + 1 : statesCount;
+                        options.definedRatio = isPartial ? 0.8 : 1.0;
+
+                        const std::string shape = std::string(isPlanted ? "plant" : "rand") + (isPartial ? "/p" : "");
+                        for (auto algorithm: config.algorithms)
+                        {
+                            failuresCount += RunShape(options, shape, algorithm, config.seedsCount, pool);
+                        }
+                    }
+                }
+
+                // deep chains need a round per class in the round-based engines and in the reference,
+                // the length is capped to keep those runs short
+                AutomataGenerator::Options options;
+                options.kind = kind;
+                options.statesCount = statesCount;
+                options.inputsCount = config.inputsCount;
+                options.inputClassesCount = config.inputClassesCount;
+                options.classesCount = std::min<size_t>(statesCount / 4 + 1, MAX_CHAIN_LENGTH);
+                options.isChain = true;
+                for (auto algorithm: config.algorithms)
+                {
+                    failuresCount += RunShape(options, "chain", algorithm, config.seedsCount, pool);
+                }
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    if (failuresCount != 0)
+    {
+        std::cerr << failuresCount << " case(s) failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+#pragma once
+#ifndef REFERENCE_MINIMIZER_H
+#define REFERENCE_MINIMIZER_H
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "AutomataGenerator.h"
+
+// Straightforward round-based minimization used as an oracle for the worklist engine
+namespace ReferenceMinimizer
+{
+    using AutomataGenerator::IndexedAutomata;
+    using AutomataGenerator::Kind;
+    using AutomataGenerator::NO_STATE;
+
+    inline std::vector<bool> GetReachableStates(const IndexedAutomata& automata)
+    {
+        std::vector<bool> reachable(automata.statesCount, false);
+        if (automata.statesCount == 0)
+        {
+            return reachable;
+        }
+
+        std::queue<uint32_t> queue;
+        reachable[0] = true;
+        queue.push(0);
+        while (!queue.empty())
+        {
+            const uint32_t state = queue.front();
+            queue.pop();
+            for (size_t input = 0; input < automata.inputsCount; ++input)
+            {
+                const uint32_t next = automata.nextStates[state * automata.inputsCount + input];
+                if (next != NO_STATE && !reachable[next])
+                {
+                    reachable[next] = true;
+                    queue.push(next);
+                }
+            }
+        }
+
+        return reachable;
+    }
+
+    // Outputs of the word read from the start state (Mealy), up to the first undefined transition
+    inline std::vector<uint32_t> Simulate(const IndexedAutomata& automata, const std::vector<uint32_t>& word)
+    {
+        std::vector<uint32_t> outputs;
+        uint32_t state = 0;
+        for (auto input: word)
+        {
+            const size_t pos = state * automata.inputsCount + input;
+            if (automata.nextStates[pos] == NO_STATE)
+            {
+                break;
+            }
+            outputs.push_back(automata.outputs[pos]);
+            state = automata.nextStates[pos];
+        }
+
+        return outputs;
+    }
+
+    // Number of states of the minimal automata: classes of reachable states are split
+    // by the classes of their successors until a round splits nothing
+    inline size_t GetMinimalStatesCount(const IndexedAutomata& automata)
+    {
+        const size_t k = automata.inputsCount;
+        const std::vector<bool> reachable = GetReachableStates(automata);
+        std::vector<uint32_t> classes(automata.statesCount, NO_STATE);
+
+        std::map<std::vector<uint32_t>, uint32_t> initialClasses;
+        for (size_t state = 0; state < automata.statesCount; ++state)
+        {
+            if (!reachable[state])
+            {
+                continue;
+            }
+
+            std::vector<uint32_t> signature;
+            if (automata.kind == Kind::Moore)
+            {
+                signature.push_back(automata.outputs[state]);
+            }
+            for (size_t input = 0; input < k; ++input)
+            {
+                const bool isDefined = automata.nextStates[state * k + input] != NO_STATE;
+                signature.push_back(isDefined ? 1 : 0);
+                if (automata.kind == Kind::Mealy)
+                {
+                    signature.push_back(isDefined ? automata.outputs[state * k + input] : 0);
+                }
+            }
+            classes[state] = initialClasses.emplace(std::move(signature), initialClasses.size()).first->second;
+        }
+
+        size_t classesCount = initialClasses.size();
+        while (true)
+        {
+            std::map<std::vector<uint32_t>, uint32_t> nextClasses;
+            std::vector<uint32_t> refined(automata.statesCount, NO_STATE);
+            for (size_t state = 0; state < automata.statesCount; ++state)
+            {
+                if (!reachable[state])
+                {
+                    continue;
+                }
+
+                std::vector<uint32_t> signature { classes[state] };
+                for (size_t input = 0; input < k; ++input)
+                {
+                    const uint32_t next = automata.nextStates[state * k + input];
+                    signature.push_back(next == NO_STATE ? NO_STATE : classes[next]);
+                }
+                refined[state] = nextClasses.emplace(std::move(signature), nextClasses.size()).first->second;
+            }
+
+            classes = std::move(refined);
+            if (nextClasses.size() == classesCount)
+            {
+                return classesCount;
+            }
+            classesCount = nextClasses.size();
+        }
+    }
+
+    // Walks the product of both automata from the start states. Every state of a minimal equivalent
+    // automata is paired with exactly one state of the other, so the walk is linear
+    inline bool AreEquivalent(const IndexedAutomata& automata, const IndexedAutomata& minimized, std::string& error)
+    {
+        if (automata.statesCount == 0 || minimized.statesCount == 0)
+        {
+            error = "empty automata";
+            return automata.statesCount == minimized.statesCount;
+        }
+
+        const size_t k = automata.inputsCount;
+        std::vector<uint32_t> pairs(automata.statesCount, NO_STATE);
+        std::vector<bool> isMinimizedReached(minimized.statesCount, false);
+        std::queue<uint32_t> queue;
+
+        pairs[0] = 0;
+        isMinimizedReached[0] = true;
+        queue.push(0);
+        while (!queue.empty())
+        {
+            const uint32_t state = queue.front();
+            const uint32_t paired = pairs[state];
+            queue.pop();
+
+            if (automata.kind == Kind::Moore && automata.outputs[state] != minimized.outputs[paired])
+            {
+                error = "different outputs of states " + std::to_string(state) + " and " + std::to_string(paired);
+                return false;
+            }
+
+            for (size_t input = 0; input < k; ++input)
+            {
+                const uint32_t next = automata.nextStates[state * k + input];
+                const uint32_t pairedNext = minimized.nextStates[paired * k + input];
+                if ((next == NO_STATE) != (pairedNext == NO_STATE))
+                {
+                    error = "transition defined in one automata only, state " + std::to_string(state);
+                    return false;
+                }
+                if (next == NO_STATE)
+                {
+                    continue;
+                }
+                if (automata.kind == Kind::Mealy
+                    && automata.outputs[state * k + input] != minimized.outputs[paired * k + input])
+                {
+                    error = "different transition outputs of states " + std::to_string(state) + " and " + std::to_string(paired);
+                    return false;
+                }
+
+                if (pairs[next] == NO_STATE)
+                {
+                    pairs[next] = pairedNext;
+                    isMinimizedReached[pairedNext] = true;
+                    queue.push(next);
+                }
+                else if (pairs[next] != pairedNext)
+                {
+                    error = "state " + std::to_string(next) + " is paired with two minimized states";
+                    return false;
+                }
+            }
+        }
+
+        if (std::find(isMinimizedReached.begin(), isMinimizedReached.end(), false) != isMinimizedReached.end())
+        {
+            error = "minimized automata has unreachable states";
+            return false;
+        }
+
+        return true;
+    }
+}
+
+#endif
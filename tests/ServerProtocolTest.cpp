@@ -0,0 +1,173 @@
+// End-to-end test of the server protocol: starts the minimization executable in server mode, sends a checked-in
+// stream of pipelined requests, closes its side and compares everything the server sends back with the
+// checked-in responses. The server must refuse a socket path taken by another file, and SIGTERM must stop it
+// cleanly and remove its socket
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace
+{
+    constexpr int CONNECT_ATTEMPTS = 200;
+    constexpr auto CONNECT_INTERVAL = std::chrono::milliseconds(50);
+
+    std::string ReadFile(const char* filename)
+    {
+        std::ifstream input(filename, std::ios::binary);
+        if (!input.is_open())
+        {
+            std::fprintf(stderr, "could not open %s\n", filename);
+            std::exit(2);
+        }
+
+        return { std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+    }
+
+    pid_t StartServer(char* executable, char* socketPath)
+    {
+        char serve[] = "serve";
+        char* serverArgs[] = { executable, serve, socketPath, nullptr };
+        pid_t server = 0;
+        if (posix_spawn(&server, executable, nullptr, nullptr, serverArgs, environ) != 0)
+        {
+            std::fprintf(stderr, "could not start %s\n", executable);
+            std::exit(2);
+        }
+
+        return server;
+    }
+
+    bool HasExitedWith(const pid_t server, const int code)
+    {
+        int status = 0;
+        waitpid(server, &status, 0);
+        return WIFEXITED(status) && WEXITSTATUS(status) == code;
+    }
+
+    // A regular file at the socket path is kept and the server fails
+    bool RefusesRegularFile(char* executable, char* socketPath)
+    {
+        std::ofstream(socketPath) << "not a socket";
+        const bool isRefused = !HasExitedWith(StartServer(executable, socketPath), 0);
+        const bool isKept = ReadFile(socketPath) == "not a socket";
+        unlink(socketPath);
+
+        return isRefused && isKept;
+    }
+
+    // The server creates the socket once it is ready, so connecting is retried until then
+    int Connect(const std::string& socketPath)
+    {
+        sockaddr_un address {};
+        address.sun_family = AF_UNIX;
+        socketPath.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+        for (int attempt = 0; attempt < CONNECT_ATTEMPTS; ++attempt)
+        {
+            const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+            {
+                return fd;
+            }
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            std::this_thread::sleep_for(CONNECT_INTERVAL);
+        }
+
+        return -1;
+    }
+
+    std::string Exchange(const int fd, const std::string& requests)
+    {
+        for (size_t sent = 0; sent < requests.size();)
+        {
+            const auto count = send(fd, requests.data() + sent, requests.size() - sent, MSG_NOSIGNAL);
+            if (count <= 0)
+            {
+                break;
+            }
+            sent += count;
+        }
+        shutdown(fd, SHUT_WR);
+
+        std::string responses;
+        char chunk[4096];
+        while (true)
+        {
+            const auto count = read(fd, chunk, sizeof(chunk));
+            if (count <= 0)
+            {
+                break;
+            }
+            responses.append(chunk, count);
+        }
+
+        return responses;
+    }
+}
+
+int main(const int argc, char** argv)
+{
+    if (argc != 5)
+    {
+        std::fprintf(stderr, "Must be: <minimizationExecutable> <socketPath> <requestsFile> <responsesFile>\n");
+        return 2;
+    }
+    const std::string socketPath = argv[2];
+    const std::string requests = ReadFile(argv[3]);
+    const std::string expected = ReadFile(argv[4]);
+
+    unlink(socketPath.c_str());
+    if (!RefusesRegularFile(argv[1], argv[2]))
+    {
+        std::fprintf(stderr, "server replaced a regular file at %s\n", socketPath.c_str());
+        return 1;
+    }
+
+    const pid_t server = StartServer(argv[1], argv[2]);
+    std::string responses;
+    const int fd = Connect(socketPath);
+    if (fd >= 0)
+    {
+        responses = Exchange(fd, requests);
+        close(fd);
+    }
+    kill(server, SIGTERM);
+    const bool isStopped = HasExitedWith(server, 0);
+    const bool isSocketRemoved = access(socketPath.c_str(), F_OK) != 0;
+    unlink(socketPath.c_str());
+
+    if (!isStopped || !isSocketRemoved)
+    {
+        std::fprintf(stderr, "SIGTERM must stop the server with status 0 and remove %s\n", socketPath.c_str());
+        return 1;
+    }
+    if (fd < 0)
+    {
+        std::fprintf(stderr, "could not connect to %s\n", socketPath.c_str());
+        return 1;
+    }
+    if (responses != expected)
+    {
+        std::fprintf(stderr, "responses differ, expected:\n%s\ngot:\n%s\n", expected.c_str(), responses.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,7 @@
+// AVX2 build of SimdRows for the AVX2 differential test, compiled with -mavx2
+#ifndef __AVX2__
+#error "SimdRowsAvx2.cpp must be compiled with AVX2"
+#endif
+
+#define SIMD_ROWS_VARIANT VectorRows
+#include "SimdRowsVariant.h"
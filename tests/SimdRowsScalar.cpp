@@ -0,0 +1,7 @@
+// Scalar build of SimdRows for the AVX2 differential test, compiled with -mno-avx2
+#ifdef __AVX2__
+#error "SimdRowsScalar.cpp must be compiled without AVX2"
+#endif
+
+#define SIMD_ROWS_VARIANT ScalarRows
+#include "SimdRowsVariant.h"
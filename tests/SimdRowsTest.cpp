@@ -0,0 +1,114 @@
+// Differential test of the AVX2 row operations: the scalar and the AVX2 builds of SimdRows must give
+// identical results on random rows of every length up to a few vector blocks, tails included.
+// Built only where the compiler and the host support AVX2
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define SIMD_ROWS_DECLARE(variant) \
+    namespace variant \
+    { \
+        bool IsVectorized(); \
+        void Gather(const uint32_t* values, const uint32_t* indexes, size_t size, uint32_t* result); \
+        bool AreEqual(const uint32_t* first, const uint32_t* second, size_t size); \
+        bool AreGatheredEqual(const uint32_t* values, const uint32_t* firstIndexes, const uint32_t* secondIndexes, \
+            size_t size); \
+        uint64_t Hash(const uint32_t* row, size_t size, uint64_t seed); \
+        uint64_t HashPairs(const uint32_t* keys, const uint32_t* values, const uint32_t* indexes, size_t size, \
+            uint64_t seed); \
+    }
+
+SIMD_ROWS_DECLARE(ScalarRows)
+SIMD_ROWS_DECLARE(VectorRows)
+
+namespace
+{
+    constexpr size_t MAX_ROW_SIZE = 40;
+    constexpr size_t VALUES_COUNT = 1000;
+    constexpr size_t ROWS_PER_SIZE = 50;
+
+    size_t Check(const bool isSame, const char* operation, const size_t size)
+    {
+        if (isSame)
+        {
+            return 0;
+        }
+
+        std::fprintf(stderr, "%s differs at row size %zu\n", operation, size);
+        return 1;
+    }
+}
+
+int main()
+{
+    if (ScalarRows::IsVectorized() || !VectorRows::IsVectorized())
+    {
+        std::fprintf(stderr, "the variants are not built as scalar and AVX2\n");
+        return 2;
+    }
+
+    std::mt19937 random(7);
+    std::uniform_int_distribution<uint32_t> valueDistribution;
+    std::uniform_int_distribution<uint32_t> indexDistribution(0, VALUES_COUNT - 1);
+    std::vector<uint32_t> values(VALUES_COUNT);
+    for (auto& value: values)
+    {
+        value = valueDistribution(random);
+    }
+
+    size_t failuresCount = 0;
+    for (size_t size = 0; size < MAX_ROW_SIZE; ++size)
+    {
+        for (size_t rowIndex = 0; rowIndex < ROWS_PER_SIZE; ++rowIndex)
+        {
+            std::vector<uint32_t> row(size), keys(size), firstIndexes(size), secondIndexes(size);
+            for (size_t i = 0; i < size; ++i)
+            {
+                row[i] = valueDistribution(random);
+                keys[i] = valueDistribution(random);
+                firstIndexes[i] = indexDistribution(random);
+                // every other row gathers the same values, so equal rows are compared too
+                secondIndexes[i] = rowIndex % 2 == 0 ? firstIndexes[i] : indexDistribution(random);
+            }
+            const uint64_t seed = valueDistribution(random);
+
+            std::vector<uint32_t> scalarGathered(size), vectorGathered(size);
+            ScalarRows::Gather(values.data(), firstIndexes.data(), size, scalarGathered.data());
+            VectorRows::Gather(values.data(), firstIndexes.data(), size, vectorGathered.data());
+            failuresCount += Check(scalarGathered == vectorGathered, "Gather", size);
+
+            // the row against itself and against a copy changed in one position
+            std::vector<uint32_t> changed = row;
+            if (size != 0)
+            {
+                changed[rowIndex % size] ^= 1;
+            }
+            for (const auto* other: { &row, &changed })
+            {
+                failuresCount += Check(ScalarRows::AreEqual(row.data(), other->data(), size)
+                    == VectorRows::AreEqual(row.data(), other->data(), size), "AreEqual", size);
+            }
+
+            failuresCount += Check(
+                ScalarRows::AreGatheredEqual(values.data(), firstIndexes.data(), secondIndexes.data(), size)
+                    == VectorRows::AreGatheredEqual(values.data(), firstIndexes.data(), secondIndexes.data(), size),
+                "AreGatheredEqual", size);
+            failuresCount += Check(ScalarRows::Hash(row.data(), size, seed) == VectorRows::Hash(row.data(), size, seed),
+                "Hash", size);
+            failuresCount += Check(
+                ScalarRows::HashPairs(keys.data(), values.data(), firstIndexes.data(), size, seed)
+                    == VectorRows::HashPairs(keys.data(), values.data(), firstIndexes.data(), size, seed),
+                "HashPairs", size);
+        }
+    }
+
+    if (failuresCount != 0)
+    {
+        std::fprintf(stderr, "%zu check(s) failed\n", failuresCount);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+// One build of the row operations, wrapped in the namespace SIMD_ROWS_VARIANT so a scalar and an AVX2 build
+// of the same header can live in one executable. Included only by SimdRowsScalar.cpp and SimdRowsAvx2.cpp
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace SIMD_ROWS_VARIANT
+{
+#include "../Utils/SimdRows.h"
+
+    bool IsVectorized()
+    {
+#ifdef __AVX2__
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Gather(const uint32_t* values, const uint32_t* indexes, const size_t size, uint32_t* result)
+    {
+        SimdRows::Gather(values, indexes, size, result);
+    }
+
+    bool AreEqual(const uint32_t* first, const uint32_t* second, const size_t size)
+    {
+        return SimdRows::AreEqual(first, second, size);
+    }
+
+    bool AreGatheredEqual(const uint32_t* values, const uint32_t* firstIndexes, const uint32_t* secondIndexes,
+        const size_t size)
+    {
+        return SimdRows::AreGatheredEqual(values, firstIndexes, secondIndexes, size);
+    }
+
+    uint64_t Hash(const uint32_t* row, const size_t size, const uint64_t seed)
+    {
+        return SimdRows::Hash(row, size, seed);
+    }
+
+    uint64_t HashPairs(const uint32_t* keys, const uint32_t* values, const uint32_t* indexes, const size_t size,
+        const uint64_t seed)
+    {
+        return SimdRows::HashPairs(keys, values, indexes, size, seed);
+    }
+}
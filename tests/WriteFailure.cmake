@@ -0,0 +1,26 @@
+# A failed write must fail the run, run by ctest as
+# cmake -DEXECUTABLE=<file> -DINPUT=<mealy fixture> -P WriteFailure.cmake
+# /dev/full takes no data, the executable writes the minimized table there once as an output file
+# and once as "-" with stdout redirected to it
+
+foreach(variable EXECUTABLE INPUT)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "${variable} is not set")
+    endif()
+endforeach()
+
+execute_process(COMMAND ${EXECUTABLE} mealy ${INPUT} /dev/full
+        RESULT_VARIABLE result
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE error)
+if(result EQUAL 0 OR output MATCHES "Executed!")
+    message(FATAL_ERROR "writing ${INPUT} to /dev/full succeeded with ${result}:\n${output}${error}")
+endif()
+
+execute_process(COMMAND ${EXECUTABLE} mealy ${INPUT} -
+        RESULT_VARIABLE result
+        OUTPUT_FILE /dev/full
+        ERROR_VARIABLE error)
+if(result EQUAL 0 OR error MATCHES "Executed!")
+    message(FATAL_ERROR "writing ${INPUT} to stdout on /dev/full succeeded with ${result}:\n${error}")
+endif()